@@ -0,0 +1,316 @@
+/*
+
+	Source file for the kernel benchmark suite. The tests follow Thread-Metric and Rhealstone:
+	every test runs its tasks for BENCH_INTERVAL ticks through the public API and reports the
+	operations they completed per second, so results can be compared between releases
+	
+	Author: Boris Kim
+
+*/
+
+#include "benchmark.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+// Operations completed by the tasks of the running test
+static volatile uint32_t benchOps;
+
+// Tasks of the running test
+static tid_t benchTids[2];
+static uint32_t benchTaskCount;
+
+// Objects shared by the test tasks, initialised before every test
+static sem_t benchSemA;
+static sem_t benchSemB;
+static mutex_t benchMutex;
+
+// Message queue of the message throughput test. queueFree counts empty slots, queueUsed full ones
+static uint32_t queueSlots[BENCH_QUEUE_SLOTS][BENCH_MESSAGE_WORDS];
+static uint32_t queueHead;
+static uint32_t queueTail;
+static sem_t queueFree;
+static sem_t queueUsed;
+static volatile uint32_t messageErrors;
+
+// Wake latency, from the task or interrupt handler returning a semaphore to the task it wakes
+static volatile uint32_t wakeCycles;
+static volatile bool wakeHandled;
+static uint32_t latencyMin;
+static uint32_t latencyMax;
+static uint64_t latencyTotal;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+static void benchReport(const char *test, uint32_t value, const char *unit) {
+	printf("BENCH %s %d %s\n", test, value, unit);
+}
+
+// Adds a test task. Tasks are created by the suite task, so they only run once it waits
+static void benchAddTask(osThreadFunc_t functionPointer, priority_t priority) {
+	osError_t error = osCreateTask(functionPointer, NULL, priority, DEFAULT_STACK_SIZE, &benchTids[benchTaskCount]);
+	
+	if(error != osNoError) {
+		osPrintError(error);
+		return;
+	}
+	benchTaskCount++;
+}
+
+// Runs the added tasks for BENCH_INTERVAL ticks, deletes them and reports their operations per second
+static void benchMeasure(const char *test) {
+	benchOps = 0;
+	
+	uint32_t startTick = osGetTickCount();
+	osDelay(BENCH_INTERVAL);
+	uint32_t ops = benchOps;
+	uint32_t ticks = osGetTickCount() - startTick;
+	
+	// Test tasks loop forever, wherever they are they are deleted
+	for(uint32_t index = 0; index < benchTaskCount; index++) {
+		osTaskDelete(benchTids[index]);
+	}
+	benchTaskCount = 0;
+	
+	benchReport(test, (uint32_t)(((uint64_t)ops * TICK_RATE_HZ) / ticks), "ops/s");
+}
+
+/*
+ Cooperative context switch. Two tasks of the same priority hand over to each other with osYield
+*/
+static void cooperativeTask(void *argument) {
+	while(true) {
+		benchOps++;
+		osYield();
+	}
+}
+
+/*
+ Preemptive context switch. A low priority task wakes a high priority one, which preempts it
+ and hands back by blocking again
+*/
+static void preemptHighTask(void *argument) {
+	while(true) {
+		osSemaphoreLend(&benchSemA);
+		benchOps++;
+		osSemaphoreReturn(&benchSemB);
+	}
+}
+
+static void preemptLowTask(void *argument) {
+	while(true) {
+		osSemaphoreReturn(&benchSemA);
+		osSemaphoreLend(&benchSemB);
+	}
+}
+
+/*
+ Semaphore ping-pong. Two tasks of the same priority take turns through a pair of semaphores
+*/
+static void pingTask(void *argument) {
+	while(true) {
+		osSemaphoreLend(&benchSemA);
+		benchOps++;
+		osSemaphoreReturn(&benchSemB);
+	}
+}
+
+static void pongTask(void *argument) {
+	while(true) {
+		osSemaphoreLend(&benchSemB);
+		osSemaphoreReturn(&benchSemA);
+	}
+}
+
+/*
+ Semaphore and mutex processing. One task takes and gives back an object nobody else uses
+*/
+static void semaphoreTask(void *argument) {
+	while(true) {
+		osSemaphoreLend(&benchSemA);
+		osSemaphoreReturn(&benchSemA);
+		benchOps++;
+	}
+}
+
+static void mutexTask(void *argument) {
+	while(true) {
+		osMutexLock(&benchMutex);
+		osMutexUnlock(&benchMutex);
+		benchOps++;
+	}
+}
+
+/*
+ Message throughput. A producer passes numbered messages to a consumer of the same priority
+ through a ring buffer, the consumer checks they arrive in order
+*/
+static void producerTask(void *argument) {
+	uint32_t sequence = 0;
+	
+	while(true) {
+		osSemaphoreLend(&queueFree);
+		
+		for(uint32_t word = 0; word < BENCH_MESSAGE_WORDS; word++) {
+			queueSlots[queueTail][word] = sequence + word;
+		}
+		queueTail = (queueTail + 1) % BENCH_QUEUE_SLOTS;
+		sequence++;
+		
+		osSemaphoreReturn(&queueUsed);
+	}
+}
+
+static void consumerTask(void *argument) {
+	uint32_t expected = 0;
+	uint32_t message[BENCH_MESSAGE_WORDS];
+	
+	while(true) {
+		osSemaphoreLend(&queueUsed);
+		
+		for(uint32_t word = 0; word < BENCH_MESSAGE_WORDS; word++) {
+			message[word] = queueSlots[queueHead][word];
+		}
+		queueHead = (queueHead + 1) % BENCH_QUEUE_SLOTS;
+		
+		osSemaphoreReturn(&queueFree);
+		
+		if(message[0] != expected) {
+			messageErrors++;
+		}
+		expected = message[0] + 1;
+		benchOps++;
+	}
+}
+
+// Clears the latency samples before a latency test
+static void latencyReset(void) {
+	latencyMin = UINT32_MAX;
+	latencyMax = 0;
+	latencyTotal = 0;
+}
+
+// Called by the woken task. Counts as one operation
+static void latencyRecord(void) {
+	uint32_t latency = DWT_CYCCNT - wakeCycles;
+	
+	if(latency < latencyMin) {
+		latencyMin = latency;
+	}
+	if(latency > latencyMax) {
+		latencyMax = latency;
+	}
+	latencyTotal += latency;
+	benchOps++;
+	
+	wakeHandled = true;
+}
+
+// benchOps still holds the number of samples taken by the last test
+static void latencyReport(const char *minTest, const char *meanTest, const char *maxTest) {
+	if(benchOps == 0) {
+		return;
+	}
+	benchReport(minTest, latencyMin, "cycles");
+	benchReport(meanTest, (uint32_t)(latencyTotal / benchOps), "cycles");
+	benchReport(maxTest, latencyMax, "cycles");
+}
+
+/*
+ Task to task latency. A low priority task returns a semaphore a high priority task waits on.
+ The latency is the time from the return to the high priority task running. The interrupt
+ latency test wakes the same task. Building with __DEFER_PREEMPT gives the latency of switching
+ on the next tick instead
+*/
+static void wakeTask(void *argument) {
+	while(true) {
+		osSemaphoreLend(&benchSemA);
+		latencyRecord();
+	}
+}
+
+static void wakeTriggerTask(void *argument) {
+	while(true) {
+		wakeHandled = false;
+		wakeCycles = DWT_CYCCNT;
+		osSemaphoreReturn(&benchSemA);
+		
+		while(wakeHandled == false);
+	}
+}
+
+/*
+ Interrupt to task latency. A low priority task pends BENCH_IRQn, whose handler wakes a high
+ priority task. The latency is the time from the handler to the task running
+*/
+void BENCH_IRQHandler(void) {
+	wakeCycles = DWT_CYCCNT;
+	osSemaphoreReturn(&benchSemA);
+}
+
+static void irqTriggerTask(void *argument) {
+	while(true) {
+		wakeHandled = false;
+		NVIC_SetPendingIRQ(BENCH_IRQn);
+		
+		while(wakeHandled == false);
+	}
+}
+
+void benchmarkRun(void) {
+	// Latencies are measured with the cycle counter
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	
+	benchReport("interval", BENCH_INTERVAL, "ticks");
+	
+	benchAddTask(cooperativeTask, osPriorityHigh);
+	benchAddTask(cooperativeTask, osPriorityHigh);
+	benchMeasure("cooperative_switch");
+	
+	osSemaphoreInit(&benchSemA, 0);
+	osSemaphoreInit(&benchSemB, 0);
+	benchAddTask(preemptHighTask, osPriorityHigh);
+	benchAddTask(preemptLowTask, osPriorityMed);
+	benchMeasure("preemptive_switch");
+	
+	osSemaphoreInit(&benchSemA, 1);
+	osSemaphoreInit(&benchSemB, 0);
+	benchAddTask(pingTask, osPriorityHigh);
+	benchAddTask(pongTask, osPriorityHigh);
+	benchMeasure("semaphore_pingpong");
+	
+	osSemaphoreInit(&benchSemA, 1);
+	benchAddTask(semaphoreTask, osPriorityHigh);
+	benchMeasure("semaphore_lend_return");
+	
+	osMutexInit(&benchMutex);
+	benchAddTask(mutexTask, osPriorityHigh);
+	benchMeasure("mutex_lock_unlock");
+	
+	osSemaphoreInit(&queueFree, BENCH_QUEUE_SLOTS);
+	osSemaphoreInit(&queueUsed, 0);
+	queueHead = 0;
+	queueTail = 0;
+	messageErrors = 0;
+	benchAddTask(producerTask, osPriorityHigh);
+	benchAddTask(consumerTask, osPriorityHigh);
+	benchMeasure("message_throughput");
+	benchReport("message_errors", messageErrors, "messages");
+	
+	osSemaphoreInit(&benchSemA, 0);
+	latencyReset();
+	benchAddTask(wakeTask, osPriorityHigh);
+	benchAddTask(wakeTriggerTask, osPriorityMed);
+	benchMeasure("wake_processing");
+	latencyReport("wake_latency_min", "wake_latency_mean", "wake_latency_max");
+	
+	osSemaphoreInit(&benchSemA, 0);
+	latencyReset();
+	NVIC_EnableIRQ(BENCH_IRQn);
+	benchAddTask(wakeTask, osPriorityHigh);
+	benchAddTask(irqTriggerTask, osPriorityMed);
+	benchMeasure("interrupt_processing");
+	NVIC_DisableIRQ(BENCH_IRQn);
+	latencyReport("interrupt_latency_min", "interrupt_latency_mean", "interrupt_latency_max");
+	
+	benchReport("done", 0, "-");
+}
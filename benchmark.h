@@ -0,0 +1,43 @@
+/*
+
+	Header file for the kernel benchmark suite
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "global_types.h"
+
+// Ticks every test runs for
+#ifndef BENCH_INTERVAL
+#define BENCH_INTERVAL 5000
+#endif
+
+// Priority of the task running the suite. Test tasks run below it
+#define BENCH_PRIORITY (osPriorityMax - 1)
+
+// Slots of the message queue used by the message throughput test, and words per message
+#define BENCH_QUEUE_SLOTS 8
+#define BENCH_MESSAGE_WORDS 4
+
+// Interrupt pended in software by the interrupt latency test. It must not be used by anything else
+#define BENCH_IRQn RIT_IRQn
+#define BENCH_IRQHandler RIT_IRQHandler
+
+// Runs every test in turn from the calling task and prints one line per result:
+//
+//   BENCH <test> <value> <unit>
+//
+// Needs 3 free TCBs and 2 DEFAULT_STACK_SIZE stacks from the pool. The calling task should
+// run at BENCH_PRIORITY
+void benchmarkRun(void);
+
+#endif //__BENCHMARK_H
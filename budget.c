@@ -0,0 +1,136 @@
+/*
+
+	Source file for execution time budget methods
+	
+	Author: Boris Kim
+
+*/
+
+#include "budget.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+
+// Replenishment timer of every task
+static osTimer_t budgetTimers[NUM_TCB];
+
+// Called from SysTick_Handler when a task with osOverrunHook overruns
+static osOverrunFunc_t overrunHook = NULL;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+// Undoes the overrun policy. Called with interrupts disabled
+static void budgetRestore(tcb_t *task) {
+	if(task->budgetOverrun == false) {
+		return;
+	}
+	task->budgetOverrun = false;
+	
+	if(task->budgetPolicy == osOverrunDemote) {
+		setTaskPriority(task, task->budgetPriority);
+	}
+	else if(task->budgetPolicy == osOverrunSuspend) {
+		changeState(task, T_READY);
+		tcbList_enqueue(readyQueue(task), task);
+	}
+}
+
+// Timer callback, runs in the timer task
+static void budgetReplenish(void *argument) {
+	tcb_t *task = (tcb_t*)argument;
+	
+	__disable_irq();
+	task->budgetUsed = 0;
+	budgetRestore(task);
+	__enable_irq();
+}
+
+bool budgetTick(void) {
+	tcb_t *task = scheduler.currTCB;
+	
+	// Task may have blocked or exited with the switch still pending
+	if((task->budget == 0) || (task->budgetOverrun == true) || (task->state != T_RUNNING)) {
+		return false;
+	}
+	
+	task->budgetUsed++;
+	if(task->budgetUsed < task->budget) {
+		return false;
+	}
+	
+	task->budgetOverrun = true;
+	
+	switch(task->budgetPolicy) {
+		
+		case osOverrunDemote :
+			task->budgetPriority = task->priority;
+			setTaskPriority(task, osPriorityNone);
+			return true;
+		
+		case osOverrunSuspend :
+			changeState(task, T_BLOCKED);
+			tcbList_remove(readyQueue(task), task);
+			triggerScheduler();
+			return true;
+		
+		default :
+			if(overrunHook != NULL) {
+				overrunHook(task->tid);
+			}
+			return false;
+	}
+}
+
+void budgetRelease(tcb_t *tcb) {
+	timerCancel(&budgetTimers[tcb->tid & TID_INDEX_MASK]);
+	tcb->budget = 0;
+	tcb->budgetOverrun = false;
+}
+
+osError_t osSetBudget(tid_t tid, uint32_t budget, uint32_t period, osOverrunPolicy_t policy) {
+	if((budget > period) || (policy > osOverrunHook)) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	osTimer_t *timer = &budgetTimers[tid & TID_INDEX_MASK];
+	
+	// Clear the old budget before applying the new one
+	budgetRestore(task);
+	task->budget = 0;
+	task->budgetUsed = 0;
+	task->budgetPolicy = policy;
+	
+	timerCancel(timer);
+	
+	if(budget == 0) {
+		__set_PRIMASK(primask);
+		return osNoError;
+	}
+	
+	// Timer calls leave interrupts disabled, so budgetTick sees the budget and policy change together
+	osError_t error = osTimerCreate(timer, budgetReplenish, task, osTimerPeriodic);
+	if(error != osNoError) {
+		__set_PRIMASK(primask);
+		return error;
+	}
+	osTimerStart(timer, period);
+	
+	// Charging starts once the timer runs
+	task->budget = budget;
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+void osSetOverrunHook(osOverrunFunc_t hook) {
+	overrunHook = hook;
+}
@@ -0,0 +1,32 @@
+/*
+
+	Header file for execution time budget methods
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __BUDGET_H
+#define __BUDGET_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// Budget Methods. A task may run for budget ticks in every period ticks, replenished by a
+// periodic software timer. When it runs out, its overrun policy is applied until the next
+// replenishment. A budget of 0 removes the limit. The overrun hook runs inside SysTick_Handler
+osError_t osSetBudget(tid_t tid, uint32_t budget, uint32_t period, osOverrunPolicy_t policy);
+void osSetOverrunHook(osOverrunFunc_t hook);
+
+// Tick hook, called from SysTick_Handler. Charges the running task a tick and returns true
+// if enforcing its budget switched it out
+bool budgetTick(void);
+
+// Stops the budget of a task that terminates. Called with interrupts disabled
+void budgetRelease(tcb_t *tcb);
+
+#endif //__BUDGET_H
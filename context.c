@@ -3,16 +3,139 @@
  * @author Andrew Morton, 2018
  */
 #include "context.h"
+#include "scheduler.h"
+#include "ezOS.h"
 
-__asm uint32_t storeContext(void) {
-	MRS		R0,PSP
+extern tcb_t tcb[NUM_TCB];
+extern tcb_t main_tcb;
+
+__asm void PendSV_Handler(void) {
+	PRESERVE8
+
+#ifdef __SWITCH_BENCH
+	LDR		R1,=__cpp(&DWT_CYCCNT)	; Timestamp on entry
+	LDR		R1,[R1]
+	LDR		R0,=__cpp(&switchEntryCycles)
+	STR		R1,[R0]
+#endif
+
+	MRS		R0,PSP					; Save R4-R11 of the outgoing task
 	STMFD	R0!,{R4-R11}
-	BX		LR
-}
 
-__asm void restoreContext(uint32_t sp) {
-	LDMFD	R0!,{R4-R11}
+	PUSH	{R4,LR}					; LR holds EXC_RETURN, R4 keeps the stack 8 byte aligned
+	CPSID	I						; SysTick outranks PendSV, keep it out of the scheduler state
+	BL		__cpp(switchTask)		; R0 = switchTask(R0)
+	CPSIE	I
+	POP		{R4,LR}
+
+	LDMFD	R0!,{R4-R11}			; Restore R4-R11 of the incoming task
 	MSR		PSP,R0
+
+#ifdef __SWITCH_BENCH
+	PUSH	{R4,LR}
+	BL		__cpp(switchBenchRecord)
+	POP		{R4,LR}
+#endif
+
 	BX		LR
 }
 
+void initMainContext(void) {
+	uint32_t *VECTOR_ZERO;
+	VECTOR_ZERO = 0x0;
+	const uint32_t KIBI = 0x100;
+	const uint32_t PSP_ENABLE = 1<<1;
+		
+	main_tcb.stackPointer = (uint32_t*)*VECTOR_ZERO;
+	main_tcb.stackBaseAddress = main_tcb.stackPointer;
+	main_tcb.stackOverflowAddress = main_tcb.stackPointer - (2*KIBI);
+	main_tcb.priority = osPriorityNone;
+	main_tcb.state = T_INACTIVE;
+	main_tcb.tid = 99;
+  
+	uint32_t* stackLocater = main_tcb.stackPointer - 2*KIBI;
+	
+	#ifdef __DEBUG
+	printf("Main Stack is at %p and overflow at %p\n", main_tcb.stackBaseAddress, main_tcb.stackOverflowAddress);
+	#endif
+	
+	// Only the main() task keeps a stack below the main stack, the others get theirs on creation
+	tcb[0].stackPointer = stackLocater;
+	tcb[0].stackBaseAddress = stackLocater;
+	tcb[0].stackOverflowAddress = stackLocater - KIBI;
+	
+	// main() is already using its stack, so only the guard word at the bottom is painted
+	*(tcb[0].stackOverflowAddress) = STACK_PAINT;
+	
+	// Copy the Main Stack contents to the process stack of the new main() task, at tcb[0]
+	uint32_t topMainStack = __get_MSP();
+	
+	uint32_t topNewMainStack = topMainStack - 2*4*KIBI;
+
+	#ifdef __DEBUG
+	printf("\nMSP was at: %p\n", (uint32_t*)__get_MSP());;
+	#endif	
+
+	for(uint32_t *mainStackLoc = main_tcb.stackBaseAddress; (uint32_t)mainStackLoc >= topMainStack; mainStackLoc--) {
+		uint32_t *copyPointer = mainStackLoc - (2*KIBI);		
+		*copyPointer = *mainStackLoc;
+		#ifdef __DEBUG
+		if(mainStackLoc == (uint32_t*)topMainStack) {
+			printf("\ncopyPointer is at: %p\n", copyPointer);
+		}
+		#endif
+	}
+	
+	// Set MSP to base address of main stack
+	__set_MSP((uint32_t)main_tcb.stackBaseAddress);
+	
+	#ifdef __DEBUG
+	printf("\nMSP is now at: %p\n", (uint32_t*)__get_MSP());;
+	#endif
+	
+	// Set PSP to the top of main() task
+	__set_PSP(topNewMainStack);
+	
+	#ifdef __DEBUG
+	printf("PSP is now at: %p\n", (uint32_t*)__get_PSP());
+	#endif
+	
+	// Switch from using the MSP to the PSP
+	__set_CONTROL((uint32_t)__get_CONTROL() | PSP_ENABLE);
+}
+
+void initContext(tcb_t *task, osThreadFunc_t functionPointer, void *functionArgument) {
+	const uint32_t PSR_VAL = 0x01000000;
+	
+	// Add register values to stack starting from PSR
+	tcb_push(task, PSR_VAL);
+	
+	// Set PC -> Function Pointer
+	tcb_push(task, (uint32_t)functionPointer);
+	
+	// Set LR -> osTaskExit, so returning from the task function terminates the task
+	tcb_push(task, (uint32_t)osTaskExit);
+	
+	// Fill R12 - R4 with placeholder bit
+	for(uint32_t count = 1; count < 14; count++) {
+		if(count == 5) {
+			// Set R0 -> Function Argument
+			tcb_push(task, (uint32_t)(functionArgument));
+		}
+		else {
+			tcb_push(task, 0x01);
+		}
+	}
+}
+
+uint32_t interruptedPC(tcb_t *task) {
+	// Hardware frame is R0-R3, R12, LR, PC and xPSR, from the lowest address
+	const uint32_t FRAME_WORDS = 8;
+	const uint32_t FRAME_PC = 6;
+	uint32_t *frame = (uint32_t *)__get_PSP();
+	
+	if((frame < task->stackOverflowAddress) || ((frame + FRAME_WORDS) > task->stackBaseAddress)) {
+		return 0;
+	}
+	return frame[FRAME_PC];
+}
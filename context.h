@@ -7,8 +7,34 @@
 
 #include <stdint.h>
 
-uint32_t storeContext(void);
-void restoreContext(uint32_t sp);
+#include "global_types.h"
 
-#endif
+/*
+ * PendSV exception handler. Saves R4-R11 of the running task on its
+ * process stack, calls switchTask() with the resulting stack pointer and
+ * restores R4-R11 from the stack pointer it returns. Runs at the lowest
+ * priority, with interrupts disabled around switchTask().
+ */
+void PendSV_Handler(void);
 
+/*
+ * Moves main() from the main stack to the process stack below it, where it
+ * continues as the idle task in tcb[0]. Handlers keep the main stack.
+ */
+void initMainContext(void);
+
+/*
+ * Builds the exception frame that the first PendSV_Handler return to a new
+ * task unstacks: PC at the task function, R0 holding its argument and LR at
+ * osTaskExit.
+ */
+void initContext(tcb_t *task, osThreadFunc_t functionPointer, void *functionArgument);
+
+/*
+ * Returns the PC the running task was interrupted at, from the exception
+ * frame SysTick_Handler was entered with. 0 if the process stack pointer
+ * is not inside the task's stack, as the frame can not be trusted then.
+ */
+uint32_t interruptedPC(tcb_t *task);
+
+#endif
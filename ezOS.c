@@ -11,151 +11,670 @@
 /**********************************************GLOBAL VARIABLES********************************************/
 // scheduler
 extern scheduler_t scheduler;
+extern uint32_t msTicks;
 
 // TCB's
 extern tcb_t tcb[NUM_TCB];
-extern tcb_t main_tcb;
+
+// Stack overflow hook, called by the check in switchTask
+extern osStackOverflowFunc_t stackOverflowHook;
+
+// Stack pool, allocated upwards from stackPoolNext
+#ifdef __STACK_POOL_REGION
+extern uint32_t Image$$STACK_POOL$$ZI$$Base[];
+extern uint32_t Image$$STACK_POOL$$ZI$$Limit[];
+#else
+static uint32_t stackPool[STACK_POOL_SIZE / sizeof(uint32_t)] __attribute__((aligned(8)));
+#endif
+static uint32_t *stackPoolNext;
+static uint32_t *stackPoolLimit;
+
+// Freed stacks, linked through a header at the bottom of each stack
+typedef struct {
+	void *nextBlock;
+	uint32_t words;
+} stackBlock_t;
+
+static stackBlock_t *stackFreeList;
+
+// Free TCBs, linked through nextTcb. tcb[0] is the main() task and is never freed
+static tcb_t *tcbFreeList;
 /**********************************************GLOBAL VARIABLES********************************************/
 
 osError_t osInitialize(void) {
 	__disable_irq();
 	
 	// Configure SysTick interrupt
-	SysTick_Config(SystemCoreClock/1000);
+	SysTick_Config(SystemCoreClock/TICK_RATE_HZ);
+	
+	// PendSV at the lowest priority, so a switch waits for every other handler to return.
+	// SysTick_Config leaves SysTick at the lowest priority too, so it is raised one level above
+	NVIC_SetPriority(PendSV_IRQn, 0xFF);
+	NVIC_SetPriority(SysTick_IRQn, (1 << __NVIC_PRIO_BITS) - 2);
 	
 	#ifdef __DEBUG
 	printf("\nosInitialize: Enter\n");
 	printGlobalLocations();
 	#endif
-	uint32_t *VECTOR_ZERO;
-	VECTOR_ZERO = 0x0;
-	const uint32_t KIBI = 0x100;
-	const uint32_t PSP_ENABLE = 1<<1;
-		
-	main_tcb.stackPointer = (uint32_t*)*VECTOR_ZERO;
-	main_tcb.stackBaseAddress = main_tcb.stackPointer;
-	main_tcb.stackOverflowAddress = main_tcb.stackPointer - (2*KIBI);
-	main_tcb.priority = osPriorityNone;
-	main_tcb.state = T_INACTIVE;
-	main_tcb.tid = 99;
-  
-	uint32_t* stackLocater = main_tcb.stackPointer - 2*KIBI;
-	
-	#ifdef __DEBUG
-	printf("Main Stack is at %p and overflow at %p\n", main_tcb.stackBaseAddress, main_tcb.stackOverflowAddress);
-	#endif
 	
 	for(int32_t stackCount = 0; stackCount < NUM_TCB; stackCount++) {
-		tcb[stackCount].stackPointer = (stackLocater - stackCount*KIBI);
-		tcb[stackCount].stackBaseAddress = (stackLocater - stackCount*KIBI);
-		tcb[stackCount].stackOverflowAddress = (stackLocater - (KIBI*(stackCount + 1)));
+		tcb[stackCount].stackPointer = NULL;
+		tcb[stackCount].stackBaseAddress = NULL;
+		tcb[stackCount].stackOverflowAddress = NULL;
 		tcb[stackCount].priority = osPriorityNone;
 		tcb[stackCount].state = T_INACTIVE;
 		tcb[stackCount].nextTcb = NULL;
-		tcb[stackCount].tid = 0;
+		tcb[stackCount].prevTcb = NULL;
+		tcb[stackCount].nextDelay = NULL;
+		tcb[stackCount].prevDelay = NULL;
+		tcb[stackCount].delayTicks = 0;
+		tcb[stackCount].waitList = NULL;
+		tcb[stackCount].waitMutex = NULL;
+		tcb[stackCount].timedOut = false;
+		tcb[stackCount].joinTcb = NULL;
+		tcb[stackCount].poolStack = false;
+		tcb[stackCount].timeSlice = 0;
+		tcb[stackCount].deadline = 0;
+		tcb[stackCount].hasDeadline = false;
+		tcb[stackCount].budget = 0;
+		tcb[stackCount].budgetOverrun = false;
+		tcb[stackCount].inTable = false;
+		tcb[stackCount].partition = 0;
+		tcb[stackCount].tid = stackCount;
 		#ifdef __DEBUG
 		printf("Stack %d is at %p and overflow at %p, TCB location: %p\n", stackCount, tcb[stackCount].stackBaseAddress, tcb[stackCount].stackOverflowAddress, &tcb[stackCount]);
 		#endif
 	}
 	
-	// Copy the Main Stack contents to the process stack of the new main() task, at tcb[0]
-	uint32_t topMainStack = __get_MSP();
+	#ifdef __STACK_POOL_REGION
+	stackPoolNext = Image$$STACK_POOL$$ZI$$Base;
+	stackPoolLimit = Image$$STACK_POOL$$ZI$$Limit;
+	#else
+	stackPoolNext = stackPool;
+	stackPoolLimit = stackPool + (STACK_POOL_SIZE / sizeof(uint32_t));
+	#endif
+	stackFreeList = NULL;
+	
+	tcbFreeList = NULL;
+	for(int32_t tcbCount = NUM_TCB - 1; tcbCount > 0; tcbCount--) {
+		tcb[tcbCount].nextTcb = tcbFreeList;
+		tcbFreeList = &tcb[tcbCount];
+	}
+	
+	// Move main() onto its own task stack, it becomes the idle task
+	initMainContext();
+	
+	// Initialize the scheduler with Idle Task
+	initScheduler();
 	
-	uint32_t topNewMainStack = topMainStack - 2*4*KIBI;
-
 	#ifdef __DEBUG
-	printf("\nMSP was at: %p\n", (uint32_t*)__get_MSP());;
-	#endif	
+	printf("\nosInitialize: Exit\n");
+	#endif
+	__enable_irq();
+	return osNoError;
+}
 
-	for(uint32_t *mainStackLoc = main_tcb.stackBaseAddress; (uint32_t)mainStackLoc >= topMainStack; mainStackLoc--) {
-		uint32_t *copyPointer = mainStackLoc - (2*KIBI);		
-		*copyPointer = *mainStackLoc;
-		#ifdef __DEBUG
-		if(mainStackLoc == (uint32_t*)topMainStack) {
-			printf("\ncopyPointer is at: %p\n", copyPointer);
+// Takes stackWords words from the stack pool, reusing a freed stack if one is large enough.
+// stackWords is updated to the size actually given. Called with interrupts disabled
+static uint32_t *stackAlloc(uint32_t *stackWords) {
+	stackBlock_t *prevBlock = NULL;
+	stackBlock_t *block = stackFreeList;
+	
+	// First fit from the stacks of terminated tasks
+	while(block != NULL) {
+		if(block->words >= *stackWords) {
+			if(prevBlock == NULL) {
+				stackFreeList = block->nextBlock;
+			}
+			else {
+				prevBlock->nextBlock = block->nextBlock;
+			}
+			
+			// Keep the unused top of the block when it can still hold a stack
+			uint32_t remainingWords = block->words - *stackWords;
+			if(remainingWords >= (MIN_STACK_SIZE / sizeof(uint32_t))) {
+				stackBlock_t *remainder = (stackBlock_t *)((uint32_t *)block + *stackWords);
+				remainder->words = remainingWords;
+				remainder->nextBlock = stackFreeList;
+				stackFreeList = remainder;
+			}
+			else {
+				*stackWords = block->words;
+			}
+			return (uint32_t *)block;
 		}
-		#endif
+		prevBlock = block;
+		block = block->nextBlock;
+	}
+	
+	if(*stackWords > (uint32_t)(stackPoolLimit - stackPoolNext)) {
+		return NULL;
+	}
+	
+	uint32_t *stack = stackPoolNext;
+	stackPoolNext += *stackWords;
+	return stack;
+}
+
+// Returns a stack to the pool. Called with interrupts disabled
+static void stackFree(uint32_t *stack, uint32_t stackWords) {
+	// Stack at the top of the pool goes straight back to it
+	if((stack + stackWords) == stackPoolNext) {
+		stackPoolNext = stack;
+		return;
 	}
 	
-	// Set MSP to base address of main stack
-	__set_MSP((uint32_t)main_tcb.stackBaseAddress);
+	stackBlock_t *block = (stackBlock_t *)stack;
+	block->words = stackWords;
+	block->nextBlock = stackFreeList;
+	stackFreeList = block;
+}
+
+tcb_t *findTask(tid_t tid) {
+	uint32_t index = tid & TID_INDEX_MASK;
+	
+	if((index == 0) || (index >= NUM_TCB)) {
+		return NULL;
+	}
 	
+	if((tcb[index].tid != tid) || (tcb[index].state == T_INACTIVE)) {
+		return NULL;
+	}
+	return &tcb[index];
+}
+
+// Sets up a task on the given stack and makes it ready. stack is the lowest address of the
+// stack, stackWords its size in words. Called with interrupts disabled and a free TCB
+static osError_t createTask(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority, uint32_t *stack, uint32_t stackWords, bool poolStack, tid_t *tid) {
 	#ifdef __DEBUG
-	printf("\nMSP is now at: %p\n", (uint32_t*)__get_MSP());;
+	//printf("\ncreateTask: Enter\n");
 	#endif
+	tcb_t *newTask = tcbFreeList;
+	tcbFreeList = newTask->nextTcb;
+	newTask->nextTcb = NULL;
+	newTask->prevTcb = NULL;
+	
+	// New ID for the reused TCB
+	newTask->tid = (((newTask->tid >> TID_INDEX_BITS) + 1) << TID_INDEX_BITS) | (newTask - tcb);
+	newTask->priority = priority;
+	newTask->stackOverflowAddress = stack;
+	newTask->stackBaseAddress = stack + stackWords;
+	newTask->stackPointer = stack + stackWords;
+	newTask->poolStack = poolStack;
+	newTask->waitList = NULL;
+	newTask->waitMutex = NULL;
+	newTask->timedOut = false;
+	newTask->joinTcb = NULL;
+	newTask->timeSlice = 0;
+	newTask->hasDeadline = false;
+	newTask->budget = 0;
+	newTask->budgetOverrun = false;
+	newTask->inTable = false;
+	newTask->partition = 0;
+	newTask->runCycles = 0;
+	newTask->switches = 0;
+	newTask->blockedTicks = 0;
+	changeState(newTask, T_READY);
 	
-	// Set PSP to the top of main() task
-	__set_PSP(topNewMainStack);
+	// Paint the whole stack, the high-water mark and the overflow check look for the paint
+	for(uint32_t *stackWord = stack; stackWord < (stack + stackWords); stackWord++) {
+		*stackWord = STACK_PAINT;
+	}
 	
 	#ifdef __DEBUG
-	printf("PSP is now at: %p\n", (uint32_t*)__get_PSP());
+	printTcbContents(newTask);
 	#endif
 	
-	// Switch from using the MSP to the PSP
-	__set_CONTROL((uint32_t)__get_CONTROL() | PSP_ENABLE);
-
-	// Initialize the scheduler with Idle Task
-	initScheduler();
+	// Initial register frame, so the first switch to the task starts it
+	initContext(newTask, functionPointer, functionArgument);
 	
 	#ifdef __DEBUG
-	printf("\nosInitialize: Exit\n");
+	printf("createTask: Right before schedule task:\n");
+	printTcbContents(newTask);
 	#endif
+	
+	tcbList_t *taskQueue = readyQueue(newTask);
+	
+	tcbList_enqueue(taskQueue, newTask);
+	
+	#ifdef __DEBUG
+	printSchedulerStatus();
+	printf("\ncreateTask: Exit, created Tid: %d\n", newTask->tid);
+	#endif
+	
+	if(tid != NULL) {
+		*tid = newTask->tid;
+	}
+	return osNoError;
+}
+
+// Takes a task off every kernel list and wakes a task joining it. The TCB and stack stay taken
+// until freeTask. Called with interrupts disabled
+static void releaseTask(tcb_t *task) {
+	tcb_t *joinTask = task->joinTcb;
+	
+	if(joinTask != NULL) {
+		task->joinTcb = NULL;
+		changeState(joinTask, T_READY);
+		tcbList_enqueue(readyQueue(joinTask), joinTask);
+	}
+	
+	budgetRelease(task);
+	
+	// Schedule table skips the slots of a terminated task
+	task->inTable = false;
+	if(scheduler.tableTcb == task) {
+		scheduler.tableTcb = NULL;
+	}
+	
+	task->state = T_INACTIVE;
+	task->waitList = NULL;
+}
+
+void freeTask(tcb_t *task) {
+	if(task->poolStack == true) {
+		stackFree(task->stackOverflowAddress, task->stackBaseAddress - task->stackOverflowAddress);
+	}
+	
+	task->nextTcb = tcbFreeList;
+	tcbFreeList = task;
+}
+
+osError_t osCreateTask(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority, uint32_t stackSize, tid_t *tid) {
+	// A stack larger than the whole pool can never fit, and would wrap around when rounded up
+	if((priority >= NUM_PRIORITIES) || (stackSize < MIN_STACK_SIZE) || (stackSize > STACK_POOL_SIZE)) {
+		return osErrorInv;
+	}
+	
+	// Keep every stack 8 byte aligned
+	uint32_t stackWords = ((stackSize + 7) & ~7u) / sizeof(uint32_t);
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if(tcbFreeList == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorRes;
+	}
+	
+	uint32_t *stack = stackAlloc(&stackWords);
+	if(stack == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorRes;
+	}
+	
+	osError_t error = createTask(functionPointer, functionArgument, priority, stack, stackWords, true, tid);
+	
+	__set_PRIMASK(primask);
+	return error;
+}
+
+osError_t osCreateTaskStatic(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority, uint32_t *stack, uint32_t stackSize, tid_t *tid) {
+	// Both ends of the stack must be 8 byte aligned, so the size is rounded down to a multiple of 8
+	stackSize &= ~7u;
+	
+	if((priority >= NUM_PRIORITIES) || (stack == NULL) || (((uintptr_t)stack & 7) != 0) || (stackSize < MIN_STACK_SIZE)) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if(tcbFreeList == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorRes;
+	}
+	
+	osError_t error = createTask(functionPointer, functionArgument, priority, stack, stackSize / sizeof(uint32_t), false, tid);
+	
+	__set_PRIMASK(primask);
+	return error;
+}
+
+void osTaskExit(void) {
+	__disable_irq();
+	
+	tcb_t *exitTask = scheduler.currTCB;
+	
+	// main() is the idle task and cannot terminate, and a handler is not a task
+	if((exitTask == &tcb[0]) || (__get_IPSR() != 0)) {
+		__enable_irq();
+		return;
+	}
+	
+	tcbList_remove(readyQueue(exitTask), exitTask);
+	
+	// PendSV still saves this task's registers into its stack, so switchTask frees the TCB and
+	// stack only once it has
+	releaseTask(exitTask);
+	triggerScheduler();
+	
 	__enable_irq();
+	
+	// Never resumed
+	while(true) {
+	}
+}
+
+osError_t osTaskDelete(tid_t tid) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *deleteTask = findTask(tid);
+	if(deleteTask == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	if(deleteTask == scheduler.currTCB) {
+		__set_PRIMASK(primask);
+		
+		// From a handler, the running task is the one it interrupted and can not exit from here
+		if(__get_IPSR() != 0) {
+			return osErrorPerm;
+		}
+		osTaskExit();
+	}
+	
+	if(deleteTask->inTable == true) {
+		// Dispatched by the schedule table, not on any list
+	}
+	else if(deleteTask->state == T_READY) {
+		tcbList_remove(readyQueue(deleteTask), deleteTask);
+	}
+	else if(deleteTask->waitList != NULL) {
+		// Blocked on a semaphore or mutex
+		waitCancel(deleteTask);
+	}
+	else if((deleteTask->budgetOverrun == true) && (deleteTask->budgetPolicy == osOverrunSuspend)) {
+		// Suspended for overrunning its budget, not on any list
+	}
+	else if(delayList_remove(deleteTask) != osNoError) {
+		// Blocked in osTaskJoin, or is the timer task
+		__set_PRIMASK(primask);
+		return osErrorPerm;
+	}
+	
+	// Task is switched out, so its registers are already saved
+	releaseTask(deleteTask);
+	freeTask(deleteTask);
+	
+	__set_PRIMASK(primask);
 	return osNoError;
 }
 
-osError_t osCreateTask(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority) {
-	#ifdef __DEBUG
-	//printf("\nosCreateTask: Enter\n");
-	#endif
-	static uint32_t taskNumber = 1;
-	const uint32_t PSR_VAL = 0x01000000;
+osError_t osTaskJoin(tid_t tid) {
+	__disable_irq();
 	
-	tcb[taskNumber].tid = taskNumber;
-	tcb[taskNumber].priority = priority;
-	changeState(&tcb[taskNumber], T_READY);
+	tcb_t *joinedTask = findTask(tid);
+	tcb_t *currTask = scheduler.currTCB;
 	
-	#ifdef __DEBUG
-	printTcbContents(&tcb[taskNumber]);
-	#endif
+	// Task has already terminated, or the ID was never valid. The TCB's reuse count only grows, so an
+	// ID that was handed out counts at least one use and no more than the TCB has had since
+	if(joinedTask == NULL) {
+		uint32_t index = tid & TID_INDEX_MASK;
+		uint32_t generation = tid >> TID_INDEX_BITS;
+		bool issued = (index != 0) && (index < NUM_TCB) && (generation != 0) && (generation <= (tcb[index].tid >> TID_INDEX_BITS));
+		__enable_irq();
+		return (issued == true) ? osNoError : osErrorInv;
+	}
+	
+	if((joinedTask == currTask) || (currTask == &tcb[0])) {
+		__enable_irq();
+		return osErrorInv;
+	}
+	
+	// Only one task can join another
+	if(joinedTask->joinTcb != NULL) {
+		__enable_irq();
+		return osErrorPerm;
+	}
+	
+	joinedTask->joinTcb = currTask;
+	changeState(currTask, T_BLOCKED);
+	tcbList_remove(readyQueue(currTask), currTask);
+	triggerScheduler();
+	
+	// Switches out here until the joined task terminates
+	__enable_irq();
+	return osNoError;
+}
+
+tid_t osTaskSelf(void) {
+	return scheduler.currTCB->tid;
+}
+
+osError_t osTaskStackHighWater(tid_t tid, uint32_t *bytes) {
+	if(bytes == NULL) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	// Stack grows down, so the paint left at the bottom is what the task never reached
+	uint32_t *stackWord = task->stackOverflowAddress;
+	while((stackWord < task->stackBaseAddress) && (*stackWord == STACK_PAINT)) {
+		stackWord++;
+	}
+	*bytes = (task->stackBaseAddress - stackWord) * sizeof(uint32_t);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osTaskStackSize(tid_t tid, uint32_t *bytes) {
+	if(bytes == NULL) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	*bytes = (task->stackBaseAddress - task->stackOverflowAddress) * sizeof(uint32_t);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+void osSetStackOverflowHook(osStackOverflowFunc_t hook) {
+	stackOverflowHook = hook;
+}
+
+#ifdef __TASK_STATS
+osError_t osTaskStats(tid_t tid, osTaskStats_t *stats) {
+	if(stats == NULL) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	readTaskStats(task, stats);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+#endif
+
+osError_t osSetTimeSlice(tid_t tid, uint32_t ticks) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	// Takes effect the next time the task is switched in
+	task->timeSlice = ticks;
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osSetPriorityTimeSlice(priority_t priority, uint32_t ticks) {
+	if((priority >= NUM_PRIORITIES) || (ticks == 0)) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	scheduler.timeSlice[priority] = ticks;
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+void osYield(void) {
+	__disable_irq();
+	
+	tcb_t *currTask = scheduler.currTCB;
+	tcbList_t *currList = readyQueue(currTask);
+	
+	// Hand the rest of the slice to the next task of the same priority, if there is one.
+	// Schedule table tasks give up their slot with osScheduleTableWait instead
+	if((currList->size > 1) && (currTask->inTable == false)) {
+		tcbList_remove(currList, currTask);
+		tcbList_enqueue(currList, currTask);
+		triggerScheduler();
+	}
+	
+	__enable_irq();
+}
+
+osError_t osSetSchedulingPolicy(osPolicy_t policy) {
+	if((policy != osPolicyFixed) && (policy != osPolicyEDF)) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	scheduler.policy = policy;
+	sortReadyQueues();
+	
+	// Task with an earlier deadline may be waiting behind the running one
+	triggerScheduler();
 	
-	// Add register values to stack starting from PSR
-	tcb_push(&tcb[taskNumber], PSR_VAL);
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osSetDeadline(tid_t tid, uint32_t deadline) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
 	
-	// Set PC -> Function Pointer
-	tcb_push(&tcb[taskNumber], (uint32_t)functionPointer);
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	task->deadline = deadline;
+	task->hasDeadline = true;
 	
-	// Fill LR - R4 with placeholder bit
-	for(uint32_t count = 0; count < 14; count++) {
-		if(count == 5) {
-			// Set R0 -> Function Argument
-			tcb_push(&tcb[taskNumber], (uint32_t)(functionArgument));
+	if((scheduler.policy == osPolicyEDF) && (task->inTable == false)) {
+		tcbList_t *taskList = readyQueue(task);
+		
+		if(task->state == T_READY) {
+			// Move it to its new place in the ready queue, preempting if it is now first
+			tcbList_remove(taskList, task);
+			tcbList_enqueue(taskList, task);
+			
+			if((task->priority == scheduler.currPriority) && (deadlineBefore(task, scheduler.currTCB) == true)) {
+				triggerScheduler();
+			}
 		}
-		else {
-			tcb_push(&tcb[taskNumber], 0x01);
+		else if((task->state == T_RUNNING) && (taskList->size > 1)) {
+			// switchTask re-sorts the running task and picks the earliest deadline
+			triggerScheduler();
 		}
 	}
 	
-	#ifdef __DEBUG
-	printf("osCreateTask: Right before schedule task:\n");
-	printTcbContents(&tcb[taskNumber]);
-	#endif
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+// Moves the running task to the delay list and switches away. Called with interrupts disabled
+static void sleepCurrentTask(uint32_t ticks) {
+	tcb_t *sleepTask = scheduler.currTCB;
 	
-	tcb_t *newTask = &tcb[taskNumber];
-	tcbList_t *taskQueue = &scheduler.readyQueueList[priority];
+	changeState(sleepTask, T_BLOCKED);
+	tcbList_remove(readyQueue(sleepTask), sleepTask);
+	delayList_insert(sleepTask, ticks);
 	
-	tcbList_enqueue(taskQueue, newTask);
+	// Switch out as soon as interrupts are enabled instead of waiting for the next tick
+	triggerScheduler();
+}
+
+osError_t osDelay(uint32_t ticks) {
+	if(ticks == 0) {
+		return osNoError;
+	}
 	
-	#ifdef __DEBUG
-	printSchedulerStatus();
-	printf("\nosCreateTask: Exit, created Tid: %d\n", tcb[taskNumber].tid);
-	#endif
+	__disable_irq();
+	
+	// Idle task has to stay ready
+	if(scheduler.currTCB == &tcb[0]) {
+		__enable_irq();
+		return osErrorPerm;
+	}
+	
+	sleepCurrentTask(ticks);
 	
-	// Increment Task Number
-	taskNumber++;
+	__enable_irq();
 	return osNoError;
 }
 
+osError_t osDelayUntil(uint32_t *previousWakeTime, uint32_t period) {
+	__disable_irq();
+	
+	if(scheduler.currTCB == &tcb[0]) {
+		__enable_irq();
+		return osErrorPerm;
+	}
+	
+	uint32_t wakeTime = *previousWakeTime + period;
+	*previousWakeTime = wakeTime;
+	
+	// Release time is measured from the previous one, so lateness does not accumulate.
+	// If it has already passed, return without sleeping
+	int32_t ticksLeft = (int32_t)(wakeTime - msTicks);
+	if(ticksLeft > 0) {
+		sleepCurrentTask((uint32_t)ticksLeft);
+	}
+	
+	__enable_irq();
+	return osNoError;
+}
+
+uint32_t osGetTickCount(void) {
+	return msTicks;
+}
+
+void osIdle(void) {
+	#ifdef __TICKLESS
+	idleSleep();
+	#endif
+}
+
 void osPrintError(osError_t error) {
 	
 	printf("Error Code: ");
@@ -181,6 +700,14 @@ void osPrintError(osError_t error) {
 			printf("Element Empty\n");
 			break;
 		
+		case osErrorRes :
+			printf("Out of Resources\n");
+			break;
+		
+		case osErrorTimeout :
+			printf("Timeout\n");
+			break;
+		
 		default : 
 			printf("Invalid Error Code\n");
 	}
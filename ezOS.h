@@ -15,13 +15,76 @@
 #include <LPC17xx.h>
 
 #include "synchro.h"
+#include "timer.h"
+#include "periodic.h"
+#include "budget.h"
+#include "schedtable.h"
+#include "partition.h"
 
 /**********************************************RTOS FUNCTIONS**********************************************/
 // Initialization method
 osError_t osInitialize(void);
 
-// Task creation method
-osError_t osCreateTask(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority);
+// Task creation methods. osCreateTask carves a stack of stackSize bytes from the stack pool, and
+// returns osErrorInv for a size larger than STACK_POOL_SIZE and osErrorRes if what is left of the
+// pool is too small. osCreateTaskStatic runs the task on a buffer declared with OS_STACK_DEFINE. It rounds stackSize
+// down to a multiple of 8 bytes and returns osErrorInv for a buffer that is not 8 byte aligned
+// ID of the new task is written to tid unless it is NULL. A task of higher priority than the
+// caller runs as soon as interrupts are enabled. Calls that do not block leave interrupts as
+// they found them, so tasks created between __disable_irq() and __enable_irq() start together
+osError_t osCreateTask(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority, uint32_t stackSize, tid_t *tid);
+osError_t osCreateTaskStatic(osThreadFunc_t functionPointer, void* functionArgument, priority_t priority, uint32_t *stack, uint32_t stackSize, tid_t *tid);
+
+// Declares a task stack of size bytes, 8 byte aligned as the AAPCS requires
+#define OS_STACK_DEFINE(name, size) static uint32_t name[(size) / sizeof(uint32_t)] __attribute__((aligned(8)))
+
+// Task termination methods. Returning from a task function is the same as osTaskExit. The TCB and
+// pool stack of a terminated task are reused by later osCreateTask calls. osTaskJoin blocks until
+// the task terminates and returns immediately if it already has, or with osErrorInv for an ID that
+// was never handed out. Deleting a task that is joining another task fails with osErrorPerm, as
+// does deleting the running task from an interrupt handler. Deleting a mutex owner leaves the
+// mutex locked
+void osTaskExit(void);
+osError_t osTaskDelete(tid_t tid);
+osError_t osTaskJoin(tid_t tid);
+tid_t osTaskSelf(void);
+
+// Stack methods. Stacks are painted with STACK_PAINT on creation. osTaskStackHighWater gives the
+// most bytes of its stack a task has used so far, osTaskStackSize the size it was given. Every
+// context switch checks the stack of the task switched out. On an overflow the hook is called
+// from PendSV with the task's ID and the kernel halts, since memory below the stack is corrupted
+osError_t osTaskStackHighWater(tid_t tid, uint32_t *bytes);
+osError_t osTaskStackSize(tid_t tid, uint32_t *bytes);
+void osSetStackOverflowHook(osStackOverflowFunc_t hook);
+
+#ifdef __TASK_STATS
+// Run time statistics. Cycles the task has run, counted at every context switch from the DWT
+// cycle counter, times it was switched in and ticks it spent blocked. CPU usage is the change in
+// runCycles between two calls over the cycles that passed
+osError_t osTaskStats(tid_t tid, osTaskStats_t *stats);
+#endif
+
+// Time slice methods. A task quantum of 0 falls back to the default of its priority level,
+// which starts at STIME. osYield gives the rest of the slice to the next task of the same priority
+osError_t osSetTimeSlice(tid_t tid, uint32_t ticks);
+osError_t osSetPriorityTimeSlice(priority_t priority, uint32_t ticks);
+void osYield(void);
+
+// Scheduling policy methods. osPolicyFixed, the default, runs tasks of equal priority in arrival
+// order. osPolicyEDF orders them by the absolute deadline set with osSetDeadline, so EDF tasks
+// should share one priority level. Tasks without a deadline run after those with one
+osError_t osSetSchedulingPolicy(osPolicy_t policy);
+osError_t osSetDeadline(tid_t tid, uint32_t deadline);
+
+// Delay methods. osDelayUntil wakes at *previousWakeTime + period and advances *previousWakeTime,
+// which should start from osGetTickCount()
+osError_t osDelay(uint32_t ticks);
+osError_t osDelayUntil(uint32_t *previousWakeTime, uint32_t period);
+uint32_t osGetTickCount(void);
+
+// Idle method, called from the idle loop in main(). With __TICKLESS, sleeps through the ticks
+// until the next timed event while no other task is ready
+void osIdle(void);
 
 // Error print method
 void osPrintError(osError_t error);
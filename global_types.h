@@ -21,28 +21,106 @@
 #define __RTGT_UART
 #endif
 
+// SysTick rate in Hz. Delays, time slices and periods are all counted in these ticks
+#define TICK_RATE_HZ 1000
+
+// Default time slice in ticks for every priority level
 #define STIME 1000
-#define NUM_PRIORITIES 4
+
+// Number of priority levels. Each level owns one bit of the ready bitmap, so 32 is the limit
+#ifndef NUM_PRIORITIES
+#define NUM_PRIORITIES 32
+#endif
+
+#if (NUM_PRIORITIES < 4) || (NUM_PRIORITIES > 32)
+#error "NUM_PRIORITIES must be between 4 and 32"
+#endif
+
+// Number of partitions. Partition 0 is the system partition, whose tasks can run in every window
+#ifndef NUM_PARTITIONS
+#define NUM_PARTITIONS 4
+#endif
+
+#if (NUM_PARTITIONS < 1) || (NUM_PARTITIONS > 256)
+#error "NUM_PARTITIONS must be between 1 and 256"
+#endif
+
+// Number of TCBs, the idle task included. Task IDs keep the index in their low byte
+#ifndef NUM_TCB
 #define NUM_TCB 6
+#endif
+
+#if (NUM_TCB < 2) || (NUM_TCB > 256)
+#error "NUM_TCB must be between 2 and 256"
+#endif
+
 #define IDLE_ID 77
 
+// Task stacks in bytes. Stacks passed to osCreateTask are carved from a pool of STACK_POOL_SIZE
+#ifndef STACK_POOL_SIZE
+#define STACK_POOL_SIZE 0x1400
+#endif
+#ifndef DEFAULT_STACK_SIZE
+#define DEFAULT_STACK_SIZE 0x400
+#endif
+#ifndef MIN_STACK_SIZE
+#define MIN_STACK_SIZE 0x80
+#endif
+
+// Task stacks are filled with this pattern when the task is created. Words still holding it
+// have never been used, which gives the high-water mark and the overflow check
+#define STACK_PAINT 0xA5A5A5A5
+
+// Take the stack pool from the STACK_POOL execution region of the scatter file, declared as
+// EMPTY, instead of a zero initialised array
+//#define __STACK_POOL_REGION
+
 //#define __DEBUG
 
+// Measure the cycle cost of every context switch with the DWT cycle counter. See printSwitchStats()
+//#define __SWITCH_BENCH
+
+// Stop the SysTick interrupt while only the idle task is ready. The idle loop must call osIdle()
+//#define __TICKLESS
+
+// Leave the switch to a readied task for the next tick instead of pending it at once, as the kernel
+// did before. Only for measuring the wake latency that immediate preemption saves, see benchmark.c
+//#define __DEFER_PREEMPT
+
+// Record scheduler events into a ring buffer and stream them over the UART. See osTraceStart()
+//#define __TRACE
+
+// Count the cycles every task runs, its context switches and the ticks it spends blocked.
+// See osTaskStats() and the shell in shell.c
+//#define __TASK_STATS
+
+// Count the PC every tick interrupts in a histogram of the running task. See osProfileStart()
+//#define __PROFILE
+
+// Count acquisitions, contention, wait and hold times of every semaphore and mutex. See osLockStatsDump()
+//#define __LOCK_STATS
+
 typedef enum {
 	osNoError 				=  0,
 	osError   				= -1,
 	osErrorOverflow 		= -2,
 	osErrorPerm 			= -3,
 	osErrorInv 				= -4,
-	osErrorEmp				= -5
+	osErrorEmp				= -5,
+	osErrorRes				= -6,
+	osErrorTimeout		= -7
 } osError_t;
 
+// Timeout of a blocking call that waits until it succeeds
+#define OS_WAIT_FOREVER 0xFFFFFFFF
+
 // Priority Enum
 typedef enum {
 	osPriorityNone	= 0,
 	osPriorityLow   = 1,
 	osPriorityMed		= 2,
-	osPriorityHigh 	= 3
+	osPriorityHigh 	= 3,
+	osPriorityMax		= NUM_PRIORITIES - 1
 } priority_t;
 
 // Task State 
@@ -53,27 +131,103 @@ typedef enum {
 	T_BLOCKED 	= 3
 } taskState_t;
 
+// Run time statistics of a task, from osTaskStats
+typedef struct {
+	uint64_t runCycles;			// Cycles of the DWT cycle counter the task has run
+	uint32_t switches;			// Times the task was switched in
+	uint32_t blockedTicks;	// Ticks the task has spent blocked, sleeping included
+} osTaskStats_t;
+
+// Overrun Policy, applied when a task runs out of budget
+typedef enum {
+	osOverrunDemote		= 0,		// Run at osPriorityNone until the budget is replenished
+	osOverrunSuspend	= 1,		// Stop running until the budget is replenished
+	osOverrunHook			= 2			// Call the overrun hook and keep running
+} osOverrunPolicy_t;
+
+// Task ID. Low byte is the TCB index, the rest counts how many times that TCB has been reused,
+// so the ID of a task that has terminated is never handed out again
 typedef uint32_t tid_t; 
+#define TID_INDEX_BITS 8
+#define TID_INDEX_MASK ((1 << TID_INDEX_BITS) - 1)
 
-typedef struct {
+typedef struct tcb {
 	tid_t tid;
 	uint32_t *stackPointer;
 	uint32_t *stackBaseAddress;
 	uint32_t *stackOverflowAddress;
-	void *nextTcb;
+	struct tcb *nextTcb;		// Neighbours in the ready queue or blocked list the task is on,
+	struct tcb *prevTcb;		// NULL at its head and tail. nextTcb also links the free TCBs
+	void *nextDelay;			// Neighbours in the delay list, NULL at its head and tail
+	void *prevDelay;
+	uint32_t delayTicks;	// Ticks after the previous task in the delay list expires
+	void *waitList;				// Semaphore or mutex blocked list the task is queued on, if any
+	void *waitMutex;			// Mutex the task is blocked on, NULL for a semaphore
+	bool timedOut;				// Last timed wait ran out before the object was handed to the task
+	void *joinTcb;				// Task blocked in osTaskJoin on this task
+	bool poolStack;				// Stack came from the stack pool and is returned to it on exit
+	uint32_t timeSlice;		// Quantum in ticks, 0 to use the default of the priority level
+	uint32_t deadline;		// Absolute tick of the current deadline, used by the EDF policy
+	bool hasDeadline;			// Tasks without a deadline run after every task with one at their priority
+	uint32_t budget;			// Ticks the task may run per budget period, 0 for no limit
+	uint32_t budgetUsed;	// Ticks run since the budget was last replenished
+	osOverrunPolicy_t budgetPolicy;
+	bool budgetOverrun;		// Budget ran out this period and the policy has been applied
+	priority_t budgetPriority;	// Priority to restore after osOverrunDemote
+	bool inTable;					// Dispatched by the schedule table instead of a ready queue
+	uint8_t partition;		// Partition whose ready queues the task is scheduled from
+	uint64_t runCycles;		// Cycles run, counted at every switch with __TASK_STATS
+	uint32_t switches;		// Times the task was switched in
+	uint32_t blockedTicks;	// Ticks spent blocked, not counting the current block
+	uint32_t blockedSince;	// Tick the current block started
+	uint32_t waitStart;		// Cycle count the task blocked on a lock at, with __LOCK_STATS
 	taskState_t state;
 	priority_t priority;
 } tcb_t;
 	
+// Scheduling Policy. With EDF, each ready queue is ordered by deadline instead of arrival,
+// so tasks of equal priority run earliest deadline first
+typedef enum {
+	osPolicyFixed		= 0,
+	osPolicyEDF			= 1
+} osPolicy_t;
+
 typedef struct {
 	uint32_t size;
 	tcb_t *head;
 	tcb_t *tail;
+	uint32_t *readyBitmap;	// Set for ready queues only, NULL for blocked lists
+	uint32_t readyMask;			// Bit owned by this queue in *readyBitmap
 } tcbList_t;
 
+// Lock statistics of a semaphore or mutex. Times are in cycles of the DWT cycle counter. A
+// semaphore is held from the lend that takes its last count until the return that gives one back
+typedef enum {
+	osLockSemaphore	= 0,
+	osLockMutex			= 1
+} osLockType_t;
+
+typedef struct {
+	void *nextLock;					// Next object in the registry of osLockStatsDump
+	osLockType_t type;
+	uint32_t acquisitions;
+	uint32_t contended;				// Acquisitions that had to wait
+	uint64_t totalWait;
+	uint32_t maxWait;
+	uint64_t totalHold;
+	uint32_t maxHold;
+	uint32_t holdStart;
+	bool held;
+	uint32_t inheritances;		// Times a waiter raised the owner's priority, mutexes only
+	uint32_t timeouts;				// Timed waits that ran out
+} osLockStats_t;
+
 typedef struct {
 	uint32_t count;
 	tcbList_t blockedList;
+	#ifdef __LOCK_STATS
+	osLockStats_t stats;
+	#endif
 } sem_t;
 
 typedef struct {
@@ -81,15 +235,74 @@ typedef struct {
 	bool inherited;
 	tcb_t *owner;
 	priority_t originalPriority;
-	tcb_t *blockedTask;
+	tcbList_t blockedList;
+	#ifdef __LOCK_STATS
+	osLockStats_t stats;
+	#endif
 } mutex_t;
 
 typedef void (*osThreadFunc_t) (void *argument);
 
+typedef void (*osOverrunFunc_t) (tid_t tid);
+
+typedef void (*osStackOverflowFunc_t) (tid_t tid);
+
+// Schedule table entry. The task runs from offset to offset + length ticks into the major frame
+typedef struct {
+	uint32_t offset;
+	tid_t tid;
+	uint32_t length;
+} osScheduleEntry_t;
+
+typedef void (*osTimerFunc_t) (void *argument);
+
+// Timer Type
+typedef enum {
+	osTimerOnce			= 0,
+	osTimerPeriodic	= 1
+} osTimerType_t;
+
+typedef struct {
+	void *nextTimer;
+	void *prevTimer;
+	osTimerFunc_t callback;
+	void *argument;
+	osTimerType_t type;
+	uint32_t period;
+	uint32_t expiry;		// Absolute tick the timer fires on
+	uint8_t level;			// Wheel level and slot holding the timer while active
+	uint8_t slot;
+	bool active;
+} osTimer_t;
+
+// Partition window. The partition is active for length ticks, windows run in order
+typedef struct {
+	uint8_t partition;
+	uint32_t length;
+} osPartitionWindow_t;
+
+typedef struct {
+	uint32_t windowTicks;		// Ticks the partition was active
+	uint32_t runTicks;			// Ticks its tasks ran, the idle task not included
+	uint32_t utilization;		// runTicks per thousand windowTicks. For the system partition, per thousand ticks
+} osPartitionStats_t;
+
 typedef struct {
-	tcb_t *currTCB;
 	tcbList_t readyQueueList[NUM_PRIORITIES];
+	uint32_t readyBitmap;		// Bit n is set while readyQueueList[n] is non-empty
+	uint32_t windowTicks;
+	uint32_t runTicks;
+} partition_t;
+
+typedef struct {
+	tcb_t *currTCB;
+	partition_t partitions[NUM_PARTITIONS];
+	uint8_t activePartition;	// Partition whose window is open, it competes with the system partition
+	uint32_t timeSlice[NUM_PRIORITIES];	// Default quantum of each priority level
+	tcb_t *delayList;				// Sleeping tasks and timed waits, ordered by wake time as a delta list
+	tcb_t *tableTcb;				// Task of the current schedule table slot, runs ahead of every ready queue
 	priority_t currPriority;
+	osPolicy_t policy;
 } scheduler_t;
 
 #endif //__GLOBAL_TYPES_H
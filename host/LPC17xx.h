@@ -0,0 +1,102 @@
+/*
+
+	Host replacement for LPC17xx.h. Provides the core peripherals and intrinsics the kernel
+	uses, backed by the host port in context.c
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __HOST_LPC17XX_H
+#define __HOST_LPC17XX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// SysTick, driven by SIGALRM
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+// System control block. Setting the PendSV bit of ICSR switches tasks once interrupts are enabled
+typedef struct {
+	volatile uint32_t ICSR;
+} SCB_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern SysTick_Type hostSysTick;
+extern SCB_Type hostSCB;
+extern CoreDebug_Type hostCoreDebug;
+
+#define SysTick (&hostSysTick)
+#define SCB (&hostSCB)
+#define CoreDebug (&hostCoreDebug)
+
+#define SysTick_CTRL_ENABLE_Msk			(1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk		(1UL << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk	(1UL << 2)
+#define SysTick_CTRL_COUNTFLAG_Msk	(1UL << 16)
+#define SysTick_LOAD_RELOAD_Msk			(0xFFFFFFUL)
+
+// Nominal core clock. Ticks and cycle counts are scaled from host time with it
+extern uint32_t SystemCoreClock;
+
+uint32_t SysTick_Config(uint32_t ticks);
+
+// Interrupts are the SIGALRM signal, masked while they are disabled
+void __disable_irq(void);
+void __enable_irq(void);
+
+// PRIMASK is 1 while the tick is masked. Setting it to 0 enables interrupts
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+
+// Exception number of the running handler, 0 in a task
+uint32_t __get_IPSR(void);
+
+static inline uint32_t __CLZ(uint32_t value) {
+	if(value == 0) {
+		return 32;
+	}
+	return (uint32_t)__builtin_clz(value);
+}
+
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+#define __WFI()
+
+// Interrupts. Only the ones used by the kernel and its tests exist on the host
+typedef enum {
+	PendSV_IRQn = -2,
+	SysTick_IRQn = -1,
+	RIT_IRQn = 29
+} IRQn_Type;
+
+#define __NVIC_PRIO_BITS 5
+
+// An enabled interrupt is taken as soon as it is pended, so it must be pended with interrupts enabled
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+
+// Priorities are fixed on the host. PendSV always waits for the handlers, which never nest
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+
+// DWT cycle counter, counting host time in cycles of SystemCoreClock
+extern volatile uint32_t hostDwtCtrl;
+volatile uint32_t *hostCycleCounter(void);
+
+#define DWT_CTRL hostDwtCtrl
+#define DWT_CYCCNT (*hostCycleCounter())
+
+// printf is not reentrant, so it runs with the tick masked
+int hostPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+#define printf hostPrintf
+
+#endif //__HOST_LPC17XX_H
@@ -0,0 +1,319 @@
+/*
+
+	Host port of the context switch. Tasks are ucontext_t contexts on their kernel stacks,
+	SysTick is a 1 ms SIGALRM interval timer and PendSV runs when the signal handler returns
+	or interrupts are enabled again
+	
+	Author: Boris Kim
+
+*/
+
+// REG_RIP in ucontext.h
+#define _GNU_SOURCE
+
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "scheduler.h"
+#include "ezOS.h"
+
+#ifdef __TICKLESS
+#error "Tickless idle reprograms the SysTick hardware and is not supported on the host"
+#endif
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+extern tcb_t tcb[NUM_TCB];
+
+SysTick_Type hostSysTick;
+SCB_Type hostSCB;
+CoreDebug_Type hostCoreDebug;
+volatile uint32_t hostDwtCtrl;
+uint32_t SystemCoreClock = 100000000;
+
+// Saved context, task function and argument of every TCB
+static ucontext_t taskContexts[NUM_TCB];
+static osThreadFunc_t taskFunctions[NUM_TCB];
+static void *taskArguments[NUM_TCB];
+
+// Interrupts enabled with NVIC_EnableIRQ, and the number of handlers running. PendSV waits for
+// every handler to return, as it has the lowest priority
+static uint32_t enabledIrqs;
+static volatile uint32_t handlerNesting;
+
+// PC the last tick interrupted, as an offset into the executable so it matches nm output
+static uint32_t tickPC;
+extern char __executable_start[];
+extern char etext[];
+
+// Character of stdin read by UARTCharReady and not received yet
+static int pendingChar = -1;
+
+static const uint32_t SET_PENDSV = 1 << 28;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+static void maskTick(int how, sigset_t *oldMask) {
+	sigset_t tickMask;
+	
+	sigemptyset(&tickMask);
+	sigaddset(&tickMask, SIGALRM);
+	sigprocmask(how, &tickMask, oldMask);
+}
+
+// Runs with the tick masked. The outgoing task resumes from swapcontext when it is switched back in
+static void pendSV(void) {
+	if(handlerNesting != 0) {
+		return;
+	}
+	
+	while((SCB->ICSR & SET_PENDSV) != 0) {
+		SCB->ICSR &= ~SET_PENDSV;
+		
+		#ifdef __SWITCH_BENCH
+		switchEntryCycles = DWT_CYCCNT;
+		#endif
+		
+		tcb_t *prevTask = scheduler.currTCB;
+		switchTask(prevTask->stackPointer);
+		tcb_t *nextTask = scheduler.currTCB;
+		
+		if(nextTask != prevTask) {
+			swapcontext(&taskContexts[prevTask - tcb], &taskContexts[nextTask - tcb]);
+		}
+		
+		#ifdef __SWITCH_BENCH
+		switchBenchRecord();
+		#endif
+	}
+}
+
+// PC in the executable's code, 0 when the signal came in a shared library
+static uint32_t contextPC(ucontext_t *context) {
+	#if defined(__x86_64__)
+	char *pc = (char *)context->uc_mcontext.gregs[REG_RIP];
+	#elif defined(__aarch64__)
+	char *pc = (char *)context->uc_mcontext.pc;
+	#else
+	char *pc = NULL;
+	#endif
+	
+	if((pc < __executable_start) || (pc >= etext)) {
+		return 0;
+	}
+	return (uint32_t)(pc - __executable_start);
+}
+
+static void tickHandler(int signal, siginfo_t *info, void *context) {
+	tickPC = contextPC(context);
+	
+	if((SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) != 0) {
+		handlerNesting++;
+		SysTick_Handler();
+		handlerNesting--;
+	}
+	pendSV();
+}
+
+static void taskEntry(void) {
+	uint32_t index = scheduler.currTCB - tcb;
+	
+	// Tasks start with interrupts enabled, as after the exception return on the target
+	__enable_irq();
+	
+	taskFunctions[index](taskArguments[index]);
+	osTaskExit();
+}
+
+void __disable_irq(void) {
+	maskTick(SIG_BLOCK, NULL);
+}
+
+void __enable_irq(void) {
+	// PendSV has the lowest priority, it runs as soon as interrupts are enabled
+	maskTick(SIG_BLOCK, NULL);
+	pendSV();
+	maskTick(SIG_UNBLOCK, NULL);
+}
+
+uint32_t __get_PRIMASK(void) {
+	sigset_t mask;
+	
+	sigprocmask(SIG_BLOCK, NULL, &mask);
+	return (sigismember(&mask, SIGALRM) == 1) ? 1 : 0;
+}
+
+void __set_PRIMASK(uint32_t priMask) {
+	if(priMask != 0) {
+		__disable_irq();
+	}
+	else {
+		__enable_irq();
+	}
+}
+
+uint32_t __get_IPSR(void) {
+	// Handlers are only told apart by the kernel, SysTick stands in for all of them
+	const uint32_t SYSTICK_EXCEPTION_NUMBER = 15;
+	
+	return (handlerNesting != 0) ? SYSTICK_EXCEPTION_NUMBER : 0;
+}
+
+// Handlers of the interrupts in IRQn_Type. Weak, so the image links without them
+void RIT_IRQHandler(void) __attribute__((weak));
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+	enabledIrqs |= 1u << irq;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+	enabledIrqs &= ~(1u << irq);
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+	void (*handler)(void) = NULL;
+	
+	if(irq == RIT_IRQn) {
+		handler = RIT_IRQHandler;
+	}
+	
+	if(((enabledIrqs & (1u << irq)) == 0) || (handler == NULL)) {
+		return;
+	}
+	
+	// Taken at once, with the tick masked on entry like any exception
+	maskTick(SIG_BLOCK, NULL);
+	handlerNesting++;
+	handler();
+	handlerNesting--;
+	pendSV();
+	maskTick(SIG_UNBLOCK, NULL);
+}
+
+uint32_t SysTick_Config(uint32_t ticks) {
+	struct sigaction action;
+	struct itimerval interval;
+	
+	SysTick->LOAD = ticks - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+	
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = tickHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigaction(SIGALRM, &action, NULL);
+	
+	// Tick period of the reload value at the nominal core clock
+	uint64_t periodMicros = ((uint64_t)ticks * 1000000) / SystemCoreClock;
+	interval.it_interval.tv_sec = periodMicros / 1000000;
+	interval.it_interval.tv_usec = periodMicros % 1000000;
+	interval.it_value = interval.it_interval;
+	setitimer(ITIMER_REAL, &interval, NULL);
+	
+	return 0;
+}
+
+volatile uint32_t *hostCycleCounter(void) {
+	static volatile uint32_t cycles;
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	cycles = (uint32_t)((((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec) * (SystemCoreClock / 1000000) / 1000);
+	return &cycles;
+}
+
+// Output shows up as it is printed, even through a pipe. Runs before main() prints anything
+__attribute__((constructor)) static void initOutput(void) {
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+int hostPrintf(const char *format, ...) {
+	sigset_t oldMask;
+	va_list arguments;
+	
+	maskTick(SIG_BLOCK, &oldMask);
+	
+	va_start(arguments, format);
+	int written = vprintf(format, arguments);
+	va_end(arguments);
+	
+	sigprocmask(SIG_SETMASK, &oldMask, NULL);
+	return written;
+}
+
+// UART0 is stdout and stdin. Only the calls made by the kernel exist on the host
+uint32_t UARTInit(uint32_t portNum, uint32_t baudrate) {
+	return 1;
+}
+
+void UARTSendChar(uint32_t portNum, uint8_t character) {
+	sigset_t oldMask;
+	
+	maskTick(SIG_BLOCK, &oldMask);
+	putchar(character);
+	sigprocmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+uint32_t UARTCharReady(uint32_t portNum) {
+	struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+	uint8_t character;
+	
+	if(pendingChar >= 0) {
+		return 1;
+	}
+	
+	// Nothing more comes once stdin is closed
+	if((poll(&input, 1, 0) != 1) || (read(STDIN_FILENO, &character, 1) != 1)) {
+		return 0;
+	}
+	pendingChar = character;
+	return 1;
+}
+
+uint8_t UARTReceiveChar(uint32_t portNum) {
+	while(UARTCharReady(portNum) == 0);
+	
+	uint8_t character = (uint8_t)pendingChar;
+	pendingChar = -1;
+	return character;
+}
+
+uint32_t interruptedPC(tcb_t *task) {
+	return tickPC;
+}
+
+void initMainContext(void) {
+	// main() keeps running on the process stack as the idle task, its context is saved on the
+	// first switch away from it. The kernel does not manage that stack on the host
+	tcb[0].stackPointer = NULL;
+	tcb[0].stackBaseAddress = NULL;
+	tcb[0].stackOverflowAddress = NULL;
+}
+
+void initContext(tcb_t *task, osThreadFunc_t functionPointer, void *functionArgument) {
+	uint32_t index = task - tcb;
+	ucontext_t *context = &taskContexts[index];
+	
+	taskFunctions[index] = functionPointer;
+	taskArguments[index] = functionArgument;
+	
+	getcontext(context);
+	context->uc_stack.ss_sp = task->stackOverflowAddress;
+	context->uc_stack.ss_size = (task->stackBaseAddress - task->stackOverflowAddress) * sizeof(uint32_t);
+	context->uc_link = NULL;
+	
+	// Starts with the tick masked, taskEntry enables it
+	sigemptyset(&context->uc_sigmask);
+	sigaddset(&context->uc_sigmask, SIGALRM);
+	makecontext(context, taskEntry, 0);
+}
@@ -0,0 +1,155 @@
+/*
+
+	Source file for partition scheduling methods
+	
+	Author: Boris Kim
+
+*/
+
+#include "partition.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+extern tcb_t tcb[NUM_TCB];
+
+// Window schedule, NULL until osPartitionStart
+static const osPartitionWindow_t *partitionWindows = NULL;
+static uint32_t windowCount;
+static uint32_t currWindow;
+static uint32_t windowTicksLeft;
+
+// Ticks counted since the statistics were reset
+static uint32_t statTicks = 0;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+bool partitionTick(void) {
+	statTicks++;
+	scheduler.partitions[scheduler.activePartition].windowTicks++;
+	
+	// Ticks are charged to the partition of the task they interrupted
+	if(scheduler.currTCB != &tcb[0]) {
+		scheduler.partitions[scheduler.currTCB->partition].runTicks++;
+	}
+	
+	if(partitionWindows == NULL) {
+		return false;
+	}
+	
+	windowTicksLeft--;
+	if(windowTicksLeft != 0) {
+		return false;
+	}
+	
+	currWindow++;
+	if(currWindow == windowCount) {
+		currWindow = 0;
+	}
+	
+	scheduler.activePartition = partitionWindows[currWindow].partition;
+	windowTicksLeft = partitionWindows[currWindow].length;
+	triggerScheduler();
+	return true;
+}
+
+#ifdef __TICKLESS
+uint32_t partitionNextEvent(uint32_t maxTicks) {
+	if((partitionWindows != NULL) && (windowTicksLeft < maxTicks)) {
+		return windowTicksLeft;
+	}
+	return maxTicks;
+}
+
+void partitionSkipTicks(uint32_t ticks) {
+	// Skipped ticks are idle ticks inside the current window, which they never close
+	statTicks += ticks;
+	scheduler.partitions[scheduler.activePartition].windowTicks += ticks;
+	
+	if(partitionWindows != NULL) {
+		windowTicksLeft -= ticks;
+	}
+}
+#endif
+
+osError_t osSetPartition(tid_t tid, uint8_t partition) {
+	if(partition >= NUM_PARTITIONS) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tcb_t *task = findTask(tid);
+	if(task == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	setTaskPartition(task, partition);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osPartitionStart(const osPartitionWindow_t *windows, uint32_t count) {
+	if((windows == NULL) || (count == 0)) {
+		return osErrorInv;
+	}
+	
+	for(uint32_t windowIndex = 0; windowIndex < count; windowIndex++) {
+		if((windows[windowIndex].partition >= NUM_PARTITIONS) || (windows[windowIndex].length == 0)) {
+			return osErrorInv;
+		}
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	// The first window opens now
+	partitionWindows = windows;
+	windowCount = count;
+	currWindow = 0;
+	windowTicksLeft = windows[0].length;
+	scheduler.activePartition = windows[0].partition;
+	triggerScheduler();
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osPartitionGetStats(uint8_t partition, osPartitionStats_t *stats) {
+	if((partition >= NUM_PARTITIONS) || (stats == NULL)) {
+		return osErrorInv;
+	}
+	
+	__disable_irq();
+	
+	stats->windowTicks = scheduler.partitions[partition].windowTicks;
+	stats->runTicks = scheduler.partitions[partition].runTicks;
+	
+	// System partition can run in every window
+	uint32_t availableTicks = stats->windowTicks;
+	if(partition == 0) {
+		availableTicks = statTicks;
+	}
+	
+	stats->utilization = 0;
+	if(availableTicks != 0) {
+		stats->utilization = (uint32_t)(((uint64_t)stats->runTicks * 1000) / availableTicks);
+	}
+	
+	__enable_irq();
+	return osNoError;
+}
+
+void osPartitionResetStats(void) {
+	__disable_irq();
+	
+	statTicks = 0;
+	for(uint32_t partitionIndex = 0; partitionIndex < NUM_PARTITIONS; partitionIndex++) {
+		scheduler.partitions[partitionIndex].windowTicks = 0;
+		scheduler.partitions[partitionIndex].runTicks = 0;
+	}
+	
+	__enable_irq();
+}
@@ -0,0 +1,38 @@
+/*
+
+	Header file for partition scheduling methods
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __PARTITION_H
+#define __PARTITION_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// Partition Methods. Each partition has its own ready queues. Windows open the partitions in turn,
+// repeating every major frame, and only tasks of the open partition and of the system partition 0
+// run. Inside that, tasks are scheduled by priority as usual, the open partition winning ties.
+// Tasks start in the system partition, and only partition 0 runs until osPartitionStart
+osError_t osSetPartition(tid_t tid, uint8_t partition);
+osError_t osPartitionStart(const osPartitionWindow_t *windows, uint32_t count);
+osError_t osPartitionGetStats(uint8_t partition, osPartitionStats_t *stats);
+void osPartitionResetStats(void);
+
+// Tick hook, called from SysTick_Handler. Counts statistics and returns true if it switched
+// to the next window
+bool partitionTick(void);
+
+#ifdef __TICKLESS
+// Ticks until the current window closes
+uint32_t partitionNextEvent(uint32_t maxTicks);
+void partitionSkipTicks(uint32_t ticks);
+#endif
+
+#endif //__PARTITION_H
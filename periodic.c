@@ -0,0 +1,191 @@
+/*
+
+	Source file for periodic task methods
+	
+	Author: Boris Kim
+
+*/
+
+#include "periodic.h"
+#include "ezOS.h"
+
+typedef struct {
+	osThreadFunc_t function;
+	void *argument;
+	uint32_t period;
+	uint32_t wcet;				// Worst case execution time of one job in ticks
+	uint32_t release;			// Tick of the first release
+	tid_t tid;
+	bool used;
+} periodicEntry_t;
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+extern uint32_t msTicks;
+extern tcb_t tcb[NUM_TCB];
+
+// One entry per task that can exist
+static periodicEntry_t periodicEntries[NUM_TCB];
+
+// Liu-Layland bound n(2^(1/n) - 1) for n tasks, in parts per million. Larger sets use ln 2
+static const uint32_t LIU_LAYLAND_BOUND[] = {1000000, 828427, 779763, 756828, 743492, 734772, 728627, 724062};
+static const uint32_t LIU_LAYLAND_LIMIT = 693147;
+static const uint32_t UTILIZATION_FULL = 1000000;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+// Checks if the task of an entry still exists, entries of terminated tasks are reused
+static bool entryActive(periodicEntry_t *entry) {
+	if(entry->used == false) {
+		return false;
+	}
+	
+	tcb_t *task = &tcb[entry->tid & TID_INDEX_MASK];
+	return ((task->tid == entry->tid) && (task->state != T_INACTIVE));
+}
+
+static void periodicTask(void *argument) {
+	periodicEntry_t *entry = (periodicEntry_t*)argument;
+	uint32_t release = entry->release;
+	tid_t self = osTaskSelf();
+	
+	osSetDeadline(self, release + entry->period);
+	
+	while(true) {
+		entry->function(entry->argument);
+		
+		// Deadline of the next job is set before sleeping, so it is ordered correctly when it wakes.
+		// Releases are counted from the first one, so a late job does not shift the ones after it
+		osSetDeadline(self, release + (2 * entry->period));
+		osDelayUntil(&release, entry->period);
+	}
+}
+
+// Task set is sorted by period. Called with interrupts disabled
+static bool taskSetSchedulable(periodicEntry_t **taskSet, uint32_t count) {
+	uint32_t utilization = 0;
+	
+	// Round up so the bound is never passed by rounding
+	for(uint32_t taskIndex = 0; taskIndex < count; taskIndex++) {
+		utilization += (uint32_t)((((uint64_t)taskSet[taskIndex]->wcet * UTILIZATION_FULL) + taskSet[taskIndex]->period - 1) / taskSet[taskIndex]->period);
+	}
+	
+	if(scheduler.policy == osPolicyEDF) {
+		return (utilization <= UTILIZATION_FULL);
+	}
+	
+	// Liu-Layland bound is sufficient but not necessary
+	uint32_t bound = LIU_LAYLAND_LIMIT;
+	if(count <= sizeof(LIU_LAYLAND_BOUND) / sizeof(LIU_LAYLAND_BOUND[0])) {
+		bound = LIU_LAYLAND_BOUND[count - 1];
+	}
+	if(utilization <= bound) {
+		return true;
+	}
+	
+	if(utilization > UTILIZATION_FULL) {
+		return false;
+	}
+	
+	// Exact response time analysis. Every task has to finish its job, with the interference from
+	// all higher priority tasks, before its period ends
+	for(uint32_t taskIndex = 0; taskIndex < count; taskIndex++) {
+		uint32_t response = taskSet[taskIndex]->wcet;
+		
+		while(true) {
+			uint32_t nextResponse = taskSet[taskIndex]->wcet;
+			
+			for(uint32_t higherIndex = 0; higherIndex < taskIndex; higherIndex++) {
+				uint32_t releases = (response + taskSet[higherIndex]->period - 1) / taskSet[higherIndex]->period;
+				nextResponse += releases * taskSet[higherIndex]->wcet;
+			}
+			
+			if(nextResponse > taskSet[taskIndex]->period) {
+				return false;
+			}
+			if(nextResponse == response) {
+				break;
+			}
+			response = nextResponse;
+		}
+	}
+	return true;
+}
+
+static priority_t periodicPriority(uint32_t rank) {
+	if(scheduler.policy == osPolicyEDF) {
+		return PERIODIC_PRIORITY_HIGH;
+	}
+	return (priority_t)(PERIODIC_PRIORITY_HIGH - rank);
+}
+
+osError_t osCreatePeriodicTask(osThreadFunc_t functionPointer, void* functionArgument, uint32_t period, uint32_t wcet, uint32_t stackSize, tid_t *tid) {
+	if((functionPointer == NULL) || (wcet == 0) || (wcet > period)) {
+		return osErrorInv;
+	}
+	
+	periodicEntry_t *taskSet[NUM_TCB];
+	periodicEntry_t *newEntry = NULL;
+	uint32_t count = 0;
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	// Free entry for the new task, and the existing task set
+	for(uint32_t entryIndex = 0; entryIndex < NUM_TCB; entryIndex++) {
+		if(entryActive(&periodicEntries[entryIndex]) == true) {
+			taskSet[count] = &periodicEntries[entryIndex];
+			count++;
+		}
+		else if(newEntry == NULL) {
+			newEntry = &periodicEntries[entryIndex];
+		}
+	}
+	
+	if((newEntry == NULL) || ((int32_t)count >= (PERIODIC_PRIORITY_HIGH - PERIODIC_PRIORITY_LOW + 1))) {
+		__set_PRIMASK(primask);
+		return osErrorRes;
+	}
+	
+	newEntry->function = functionPointer;
+	newEntry->argument = functionArgument;
+	newEntry->period = period;
+	newEntry->wcet = wcet;
+	newEntry->release = msTicks;
+	newEntry->used = false;
+	
+	// Rate monotonic order, the new task goes behind tasks of the same period
+	uint32_t rank = count;
+	while((rank > 0) && (taskSet[rank - 1]->period > period)) {
+		taskSet[rank] = taskSet[rank - 1];
+		rank--;
+	}
+	taskSet[rank] = newEntry;
+	count++;
+	
+	if(taskSetSchedulable(taskSet, count) == false) {
+		__set_PRIMASK(primask);
+		return osErrorRes;
+	}
+	
+	// Restores the interrupt mask, so interrupts stay disabled
+	osError_t error = osCreateTask(periodicTask, newEntry, periodicPriority(rank), stackSize, &newEntry->tid);
+	
+	if(error != osNoError) {
+		__set_PRIMASK(primask);
+		return error;
+	}
+	newEntry->used = true;
+	
+	// Tasks with longer periods move down a level
+	for(uint32_t entryIndex = 0; entryIndex < count; entryIndex++) {
+		tcb_t *task = &tcb[taskSet[entryIndex]->tid & TID_INDEX_MASK];
+		setTaskPriority(task, periodicPriority(entryIndex));
+	}
+	
+	__set_PRIMASK(primask);
+	
+	if(tid != NULL) {
+		*tid = newEntry->tid;
+	}
+	return osNoError;
+}
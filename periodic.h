@@ -0,0 +1,29 @@
+/*
+
+	Header file for periodic task methods
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __PERIODIC_H
+#define __PERIODIC_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// Periodic tasks get rate monotonic priorities from this band, shortest period highest.
+// Under osPolicyEDF they all run at PERIODIC_PRIORITY_HIGH, ordered by deadline
+#define PERIODIC_PRIORITY_LOW (osPriorityHigh + 1)
+#define PERIODIC_PRIORITY_HIGH (osPriorityMax - 1)
+
+// Periodic Task Methods. The job function is called once per period, released at exact multiples
+// of the period from creation, with the end of the period as its deadline. Creation fails with
+// osErrorRes if the task set including the new task would not be schedulable
+osError_t osCreatePeriodicTask(osThreadFunc_t functionPointer, void* functionArgument, uint32_t period, uint32_t wcet, uint32_t stackSize, tid_t *tid);
+
+#endif //__PERIODIC_H
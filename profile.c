@@ -0,0 +1,111 @@
+/*
+
+	Source file for the PC sampling profiler. Every tick, the PC the running task was interrupted
+	at is counted in a histogram of that task. The histograms are printed with osProfileDump and
+	matched to functions on the host by tools/profile_symbolize.py
+	
+	Author: Boris Kim
+
+*/
+
+#include "profile.h"
+#include "ezOS.h"
+
+#ifdef __PROFILE
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+extern tcb_t tcb[NUM_TCB];
+
+// Histogram of every TCB and the task it holds samples of. A TCB reused by a new task starts over
+static profileSlot_t profileSlots[NUM_TCB][PROFILE_SLOTS];
+static tid_t profileTids[NUM_TCB];
+static uint32_t profileDropped[NUM_TCB];
+
+static volatile bool profiling = false;
+
+static const uint32_t PROFILE_MASK = PROFILE_SLOTS - 1;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+static void clearHistogram(uint32_t index) {
+	for(uint32_t slot = 0; slot < PROFILE_SLOTS; slot++) {
+		profileSlots[index][slot].bucket = 0;
+		profileSlots[index][slot].count = 0;
+	}
+	profileDropped[index] = 0;
+}
+
+void profileTick(void) {
+	if(profiling == false) {
+		return;
+	}
+	
+	tcb_t *task = scheduler.currTCB;
+	uint32_t index = task - tcb;
+	
+	if(profileTids[index] != task->tid) {
+		clearHistogram(index);
+		profileTids[index] = task->tid;
+	}
+	
+	// No trustworthy frame, or a PC in the first bucket, which is never code
+	uint32_t bucket = interruptedPC(task) >> PROFILE_BUCKET_SHIFT;
+	if(bucket == 0) {
+		profileDropped[index]++;
+		return;
+	}
+	
+	// Open addressing. Multiplying by an odd constant keeps neighbouring buckets in different slots
+	profileSlot_t *histogram = profileSlots[index];
+	uint32_t slot = (bucket * 2654435761u) & PROFILE_MASK;
+	
+	for(uint32_t probe = 0; probe < PROFILE_PROBES; probe++) {
+		if(histogram[slot].bucket == bucket) {
+			histogram[slot].count++;
+			return;
+		}
+		if(histogram[slot].bucket == 0) {
+			histogram[slot].bucket = bucket;
+			histogram[slot].count = 1;
+			return;
+		}
+		slot = (slot + 1) & PROFILE_MASK;
+	}
+	profileDropped[index]++;
+}
+
+void osProfileStart(void) {
+	profiling = true;
+}
+
+void osProfileStop(void) {
+	profiling = false;
+}
+
+void osProfileReset(void) {
+	__disable_irq();
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		clearHistogram(index);
+		profileTids[index] = 0;
+	}
+	__enable_irq();
+}
+
+void osProfileDump(void) {
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		// Task IDs are never 0, so the TCB has not been sampled
+		if(profileTids[index] == 0) {
+			continue;
+		}
+		
+		for(uint32_t slot = 0; slot < PROFILE_SLOTS; slot++) {
+			profileSlot_t entry = profileSlots[index][slot];
+			if(entry.bucket != 0) {
+				printf("PROFILE %d %08x %d\n", profileTids[index], entry.bucket << PROFILE_BUCKET_SHIFT, entry.count);
+			}
+		}
+		printf("PROFILE %d dropped %d\n", profileTids[index], profileDropped[index]);
+	}
+}
+
+#endif
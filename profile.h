@@ -0,0 +1,55 @@
+/*
+
+	Header file for the PC sampling profiler
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "global_types.h"
+
+// Histogram slots of every task. A sampled PC that finds no slot within PROFILE_PROBES probes is
+// counted as dropped, so a tick never costs more than PROFILE_PROBES compares
+#ifndef PROFILE_SLOTS
+#define PROFILE_SLOTS 64
+#endif
+#define PROFILE_PROBES 8
+
+#if (PROFILE_SLOTS & (PROFILE_SLOTS - 1)) != 0
+#error "PROFILE_SLOTS must be a power of two"
+#endif
+
+// PCs are counted in buckets of 1 << PROFILE_BUCKET_SHIFT bytes. Wider buckets need fewer slots,
+// and a bucket still falls in one function as long as it is narrower than the functions
+#ifndef PROFILE_BUCKET_SHIFT
+#define PROFILE_BUCKET_SHIFT 2
+#endif
+
+typedef struct {
+	uint32_t bucket;		// PC >> PROFILE_BUCKET_SHIFT, 0 while the slot is free
+	uint32_t count;
+} profileSlot_t;
+
+#ifdef __PROFILE
+// Samples the PC of the running task. Called by SysTick_Handler
+void profileTick(void);
+
+// Profiler methods. Samples are taken every tick between osProfileStart and osProfileStop.
+// osProfileDump prints "PROFILE <tid> <pc> <count>" for every bucket and "PROFILE <tid> dropped
+// <count>" for samples that found no slot. tools/profile_symbolize.py turns the lines into
+// functions with the image's symbol table
+void osProfileStart(void);
+void osProfileStop(void);
+void osProfileReset(void);
+void osProfileDump(void);
+#endif
+
+#endif //__PROFILE_H
@@ -0,0 +1,202 @@
+/*
+
+	Source file for static schedule table methods
+	
+	Author: Boris Kim
+
+*/
+
+#include "schedtable.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern scheduler_t scheduler;
+extern tcb_t tcb[NUM_TCB];
+
+// Running table, NULL while none is
+static const osScheduleEntry_t *scheduleTable = NULL;
+static uint32_t tableCount;
+static uint32_t tableMajorFrame;
+
+// Tick of the major frame the next SysTick processes, the next entry to start, and the tick the
+// current slot ends on
+static uint32_t frameTick;
+static uint32_t nextEntry;
+static uint32_t slotEnd;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+bool tableTick(void) {
+	if(scheduleTable == NULL) {
+		return false;
+	}
+	
+	bool dispatch = false;
+	
+	if((scheduler.tableTcb != NULL) && (frameTick == slotEnd)) {
+		scheduler.tableTcb = NULL;
+		dispatch = true;
+	}
+	
+	if(frameTick == scheduleTable[nextEntry].offset) {
+		const osScheduleEntry_t *entry = &scheduleTable[nextEntry];
+		tcb_t *task = &tcb[entry->tid & TID_INDEX_MASK];
+		
+		// Task may have terminated since the table started
+		if((task->tid == entry->tid) && (task->inTable == true)) {
+			// Waiting for this slot in osScheduleTableWait. changeState counts the blocked time and
+			// traces the unblock
+			if(task->state == T_BLOCKED) {
+				changeState(task, T_READY);
+			}
+			scheduler.tableTcb = task;
+			slotEnd = (entry->offset + entry->length) % tableMajorFrame;
+			dispatch = true;
+		}
+		
+		nextEntry++;
+		if(nextEntry == tableCount) {
+			nextEntry = 0;
+		}
+	}
+	
+	frameTick++;
+	if(frameTick == tableMajorFrame) {
+		frameTick = 0;
+	}
+	
+	if(dispatch == true) {
+		triggerScheduler();
+	}
+	return dispatch;
+}
+
+#ifdef __TICKLESS
+uint32_t tableNextEvent(uint32_t maxTicks) {
+	if(scheduleTable == NULL) {
+		return maxTicks;
+	}
+	
+	uint32_t ticks = ((scheduleTable[nextEntry].offset + tableMajorFrame - frameTick) % tableMajorFrame) + 1;
+	
+	if(scheduler.tableTcb != NULL) {
+		uint32_t endTicks = ((slotEnd + tableMajorFrame - frameTick) % tableMajorFrame) + 1;
+		if(endTicks < ticks) {
+			ticks = endTicks;
+		}
+	}
+	
+	if(ticks < maxTicks) {
+		return ticks;
+	}
+	return maxTicks;
+}
+
+void tableSkipTicks(uint32_t ticks) {
+	// Ticks skipped by tickless idle never start or end a slot
+	if(scheduleTable != NULL) {
+		frameTick = (frameTick + ticks) % tableMajorFrame;
+	}
+}
+#endif
+
+osError_t osScheduleTableStart(const osScheduleEntry_t *table, uint32_t count, uint32_t majorFrame) {
+	if((table == NULL) || (count == 0) || (majorFrame == 0)) {
+		return osErrorInv;
+	}
+	
+	// Slots are sorted, inside the major frame, and do not overlap
+	for(uint32_t entryIndex = 0; entryIndex < count; entryIndex++) {
+		if((table[entryIndex].length == 0) || ((table[entryIndex].offset + table[entryIndex].length) > majorFrame)) {
+			return osErrorInv;
+		}
+		if((entryIndex > 0) && (table[entryIndex].offset < (table[entryIndex - 1].offset + table[entryIndex - 1].length))) {
+			return osErrorInv;
+		}
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if(scheduleTable != NULL) {
+		__set_PRIMASK(primask);
+		return osErrorPerm;
+	}
+	
+	// Only tasks waiting in a ready queue can be handed to the table
+	for(uint32_t entryIndex = 0; entryIndex < count; entryIndex++) {
+		tcb_t *task = findTask(table[entryIndex].tid);
+		
+		if(task == NULL) {
+			__set_PRIMASK(primask);
+			return osErrorInv;
+		}
+		if((task->inTable == false) && (task->state != T_READY)) {
+			__set_PRIMASK(primask);
+			return osErrorPerm;
+		}
+		
+		if(task->inTable == false) {
+			tcbList_remove(readyQueue(task), task);
+			task->inTable = true;
+		}
+	}
+	
+	scheduleTable = table;
+	tableCount = count;
+	tableMajorFrame = majorFrame;
+	frameTick = 0;
+	nextEntry = 0;
+	scheduler.tableTcb = NULL;
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osScheduleTableStop(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if(scheduleTable == NULL) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	// Table tasks go back to normal priority scheduling
+	for(uint32_t index = 1; index < NUM_TCB; index++) {
+		if(tcb[index].inTable == false) {
+			continue;
+		}
+		tcb[index].inTable = false;
+		
+		// Table task that stops the table keeps running until the switch
+		if(tcb[index].state != T_RUNNING) {
+			changeState(&tcb[index], T_READY);
+		}
+		tcbList_enqueue(readyQueue(&tcb[index]), &tcb[index]);
+	}
+	
+	scheduleTable = NULL;
+	scheduler.tableTcb = NULL;
+	triggerScheduler();
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osScheduleTableWait(void) {
+	__disable_irq();
+	
+	tcb_t *currTask = scheduler.currTCB;
+	if(currTask->inTable == false) {
+		__enable_irq();
+		return osErrorPerm;
+	}
+	
+	// Not on any list, tableTick makes it ready again when its next slot starts
+	changeState(currTask, T_BLOCKED);
+	scheduler.tableTcb = NULL;
+	triggerScheduler();
+	
+	__enable_irq();
+	return osNoError;
+}
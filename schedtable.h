@@ -0,0 +1,37 @@
+/*
+
+	Header file for static schedule table methods
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __SCHEDTABLE_H
+#define __SCHEDTABLE_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// Schedule Table Methods. While a table runs, each entry gives its task the processor from offset
+// to offset + length in every major frame, ahead of every priority level. Tasks in the table are
+// taken off the ready queues, so outside their slots the other tasks run by priority as usual.
+// Entries are sorted by offset and must not overlap. A table task gives up the rest of its slot
+// with osScheduleTableWait, and must not block any other way while the table runs
+osError_t osScheduleTableStart(const osScheduleEntry_t *table, uint32_t count, uint32_t majorFrame);
+osError_t osScheduleTableStop(void);
+osError_t osScheduleTableWait(void);
+
+// Tick hook, called from SysTick_Handler. Starts and ends slots, returns true if it switched tasks
+bool tableTick(void);
+
+#ifdef __TICKLESS
+// Ticks until the next slot starts or ends
+uint32_t tableNextEvent(uint32_t maxTicks);
+void tableSkipTicks(uint32_t ticks);
+#endif
+
+#endif //__SCHEDTABLE_H
@@ -7,14 +7,15 @@
 */
 
 #include "scheduler.h"
+#include "timer.h"
+#include "budget.h"
+#include "schedtable.h"
+#include "partition.h"
+#include "synchro.h"
 
 /***************************************GLOBAL DECLARATIONS****************************************************/
-const uint32_t timeSlice = STIME;
 uint32_t msTicks = 0; // counter for timeslice
-uint32_t countDown = timeSlice;
-
-// Global scheduler boolean
-bool runScheduler = false;
+uint32_t countDown = STIME;
 
 // Global TCB
 tcb_t tcb[NUM_TCB];
@@ -22,13 +23,40 @@ tcb_t main_tcb;
 
 // Global scheduler
 scheduler_t scheduler;
-	
+
+// Called with the ID of a task that has overflowed its stack, before the kernel halts
+osStackOverflowFunc_t stackOverflowHook = NULL;
+
+#ifdef __TICKLESS
+// SysTick reload for one tick, and the most ticks the 24 bit reload register can hold
+static uint32_t tickReload;
+static uint32_t maxIdleTicks;
+#endif
+
+#ifdef __TASK_STATS
+// Cycle count of the last switch or tick, the running task has run since then
+static uint32_t statsSwitchCycles;
+#endif
+
+#ifdef __DEFER_PREEMPT
+// A task was readied that outranks the running one, switch on the next tick
+static bool deferredSwitch = false;
+#endif
+
+#ifdef __SWITCH_BENCH
+// Context switch cost in cycles, measured by PendSV_Handler
+uint32_t switchEntryCycles;
+static uint32_t switchMinCycles = UINT32_MAX;
+static uint32_t switchMaxCycles = 0;
+static uint64_t switchTotalCycles = 0;
+static uint32_t switchCount = 0;
+#endif
+
 static const uint32_t SET_PENDSV = 1 << 28;
-static const uint32_t CLEAR_PENDSV = 1 << 27;
 /***************************************GLOBAL DECLARATIONS****************************************************/
 
 void printGlobalLocations(void) {
-	//printf("runScheduler: %p, value is %d, scheduler: %p, TCB Array: %p, main TCB: %p\n", &runScheduler, (uint32_t)runScheduler, &scheduler, &tcb, &main_tcb);
+	//printf("scheduler: %p, TCB Array: %p, main TCB: %p\n", &scheduler, &tcb, &main_tcb);
 }
 
 void printTcbContents(tcb_t *tcb) {
@@ -52,6 +80,49 @@ osError_t tcb_push(tcb_t *tcb, uint32_t content) {
 	return osNoError;
 }
 
+bool deadlineBefore(tcb_t *tcb, tcb_t *otherTcb) {
+	if(tcb->hasDeadline == false) {
+		return false;
+	}
+	if(otherTcb->hasDeadline == false) {
+		return true;
+	}
+	// Signed difference so the comparison survives the tick counter wrapping
+	return ((int32_t)(tcb->deadline - otherTcb->deadline) < 0);
+}
+
+// Places a task in a deadline ordered ready queue, behind every task whose deadline is not later.
+// Returns false if it belongs at the tail. Called on non-empty lists only
+static bool tcbList_insertOrdered(tcbList_t *list, tcb_t *tcb) {
+	tcb_t *currTcb = list->head;
+	
+	// Running task stays at the head until it is switched out, switchTask re-sorts it then
+	if(currTcb->state == T_RUNNING) {
+		currTcb = currTcb->nextTcb;
+	}
+	
+	while((currTcb != NULL) && (deadlineBefore(tcb, currTcb) == false)) {
+		currTcb = currTcb->nextTcb;
+	}
+	
+	if(currTcb == NULL) {
+		return false;
+	}
+	
+	// Link in front of currTcb
+	tcb->nextTcb = currTcb;
+	tcb->prevTcb = currTcb->prevTcb;
+	if(currTcb->prevTcb == NULL) {
+		list->head = tcb;
+	}
+	else {
+		currTcb->prevTcb->nextTcb = tcb;
+	}
+	currTcb->prevTcb = tcb;
+	(list->size)++;
+	return true;
+}
+
 osError_t tcbList_enqueue(tcbList_t *list, tcb_t *tcb) {
 	#ifdef __DEBUG
 	printf("\ntcbList_enqueue: Enter, enqueue TID: %d\n", tcb->tid);
@@ -59,10 +130,17 @@ osError_t tcbList_enqueue(tcbList_t *list, tcb_t *tcb) {
 	
 	// Check if the list is empty. If yes, then set head and tail to enqueued tcb and increment size
 	if(list->size == 0) {
+		tcb->nextTcb = NULL;
+		tcb->prevTcb = NULL;
 		list->head = tcb;
 		list->tail = tcb;
 		(list->size)++;
 		
+		// Mark the priority level as ready
+		if(list->readyBitmap != NULL) {
+			*(list->readyBitmap) |= list->readyMask;
+		}
+		
 		#ifdef __DEBUG
 		printListContents(list);
 		printSchedulerStatus();
@@ -71,7 +149,21 @@ osError_t tcbList_enqueue(tcbList_t *list, tcb_t *tcb) {
 		return osNoError;
 	}
 	
-	// Set current tail TCB to point to enqueued TCB
+	// EDF ready queues are kept in deadline order
+	if((list->readyBitmap != NULL) && (scheduler.policy == osPolicyEDF) && (tcb->hasDeadline == true)) {
+		if(tcbList_insertOrdered(list, tcb) == true) {
+			#ifdef __DEBUG
+			printListContents(list);
+			printSchedulerStatus();
+			printf("\ntcbList_enqueue: Exit\n");
+			#endif
+			return osNoError;
+		}
+	}
+	
+	// Link the enqueued TCB behind the current tail
+	tcb->nextTcb = NULL;
+	tcb->prevTcb = list->tail;
 	list->tail->nextTcb = tcb;
 	
 	// Assign enqueued TCB to tail
@@ -93,37 +185,16 @@ tcb_t *tcbList_dequeue(tcbList_t *list) {
 	printf("\ntcbList_dequeue: Enter\n");
 	#endif
 	// Return NULL if queue is empty
-	tcb_t *returnTcb;
+	tcb_t *returnTcb = list->head;
 	
-	if(list->head == NULL) {
+	if(returnTcb == NULL) {
 		#ifdef __DEBUG
 		printf("\ntcbList_dequeue: Exit Error, Empty Queue\n");
 		#endif
 		return NULL;
 	}
 	
-	// Check if the list has only one element
-	if(list->size == 1) {
-		returnTcb = list->head;
-		list->head = NULL;
-		list->tail = NULL;
-		(list->size)--;
-		
-		#ifdef __DEBUG
-		printListContents(list);
-		printSchedulerStatus();		
-		printf("\ntcbList_dequeue: Exit");
-		#endif
-		return returnTcb;
-	}
-	
-	// Set head to dequeued TCB's next TCB
-	returnTcb = list->head;
-	list->head = list->head->nextTcb;
-	
-	// Assign dequeued TCB's next to NULL
-	returnTcb->nextTcb = NULL;
-	(list->size)--;
+	tcbList_remove(list, returnTcb);
 	
 	#ifdef __DEBUG
 	printListContents(list);
@@ -133,6 +204,163 @@ tcb_t *tcbList_dequeue(tcbList_t *list) {
 	return returnTcb;
 }
 
+osError_t tcbList_remove(tcbList_t *list, tcb_t *tcb) {
+	// Only a task at the head has no previous task, anything else is on another list
+	if((tcb->prevTcb == NULL) && (list->head != tcb)) {
+		return osErrorInv;
+	}
+	
+	// Unlink from both neighbours, the list's head and tail stand in for missing ones
+	if(tcb->prevTcb == NULL) {
+		list->head = tcb->nextTcb;
+	}
+	else {
+		tcb->prevTcb->nextTcb = tcb->nextTcb;
+	}
+	
+	if(tcb->nextTcb == NULL) {
+		list->tail = tcb->prevTcb;
+	}
+	else {
+		tcb->nextTcb->prevTcb = tcb->prevTcb;
+	}
+	
+	tcb->nextTcb = NULL;
+	tcb->prevTcb = NULL;
+	(list->size)--;
+	
+	// Priority level has no ready tasks left
+	if((list->size == 0) && (list->readyBitmap != NULL)) {
+		*(list->readyBitmap) &= ~(list->readyMask);
+	}
+	return osNoError;
+}
+
+void sortReadyQueues(void) {
+	for(uint32_t partitionIndex = 0; partitionIndex < NUM_PARTITIONS; partitionIndex++) {
+		for(uint32_t priorityIndex = 0; priorityIndex < NUM_PRIORITIES; priorityIndex++) {
+			tcbList_t *list = &scheduler.partitions[partitionIndex].readyQueueList[priorityIndex];
+			
+			if(list->size < 2) {
+				continue;
+			}
+			
+			// Running task goes back first so it stays at the head
+			tcb_t *runningTcb = NULL;
+			if((scheduler.currTCB->state == T_RUNNING) && (scheduler.currTCB->priority == priorityIndex) && 
+			 (scheduler.currTCB->partition == partitionIndex) && (scheduler.currTCB->inTable == false)) {
+				runningTcb = scheduler.currTCB;
+				tcbList_remove(list, runningTcb);
+			}
+			
+			// Empty the queue and enqueue every task again in the order of the current policy.
+			// Enqueueing rewrites the links of a task, so the next one is read first
+			tcb_t *currTcb = list->head;
+			uint32_t size = list->size;
+			list->size = 0;
+			list->head = NULL;
+			list->tail = NULL;
+			
+			if(runningTcb != NULL) {
+				tcbList_enqueue(list, runningTcb);
+			}
+			
+			for(uint32_t count = 0; count < size; count++) {
+				tcb_t *nextTcb = currTcb->nextTcb;
+				tcbList_enqueue(list, currTcb);
+				currTcb = nextTcb;
+			}
+		}
+	}
+}
+
+void delayList_insert(tcb_t *tcb, uint32_t ticks) {
+	tcb_t *prevTask = NULL;
+	tcb_t *currTask = scheduler.delayList;
+	
+	// Walk past every task that wakes no later than this one, consuming their deltas
+	while((currTask != NULL) && (ticks >= currTask->delayTicks)) {
+		ticks -= currTask->delayTicks;
+		prevTask = currTask;
+		currTask = currTask->nextDelay;
+	}
+	
+	tcb->delayTicks = ticks;
+	tcb->nextDelay = currTask;
+	tcb->prevDelay = prevTask;
+	
+	// Task after the inserted one now wakes relative to it
+	if(currTask != NULL) {
+		currTask->delayTicks -= ticks;
+		currTask->prevDelay = tcb;
+	}
+	
+	if(prevTask == NULL) {
+		scheduler.delayList = tcb;
+	}
+	else {
+		prevTask->nextDelay = tcb;
+	}
+}
+
+osError_t delayList_remove(tcb_t *tcb) {
+	// Only the head has no previous task, anything else is not sleeping
+	if((tcb->prevDelay == NULL) && (scheduler.delayList != tcb)) {
+		return osErrorInv;
+	}
+	
+	// Task after the removed one inherits its delta
+	tcb_t *nextTask = tcb->nextDelay;
+	tcb_t *prevTask = tcb->prevDelay;
+	if(nextTask != NULL) {
+		nextTask->delayTicks += tcb->delayTicks;
+		nextTask->prevDelay = prevTask;
+	}
+	
+	if(prevTask == NULL) {
+		scheduler.delayList = nextTask;
+	}
+	else {
+		prevTask->nextDelay = nextTask;
+	}
+	
+	tcb->nextDelay = NULL;
+	tcb->prevDelay = NULL;
+	return osNoError;
+}
+
+void delayList_tick(void) {
+	if(scheduler.delayList == NULL) {
+		return;
+	}
+	
+	// Only the head carries the remaining time, every other delta is relative to it
+	(scheduler.delayList->delayTicks)--;
+	
+	while((scheduler.delayList != NULL) && (scheduler.delayList->delayTicks == 0)) {
+		tcb_t *wokenTask = scheduler.delayList;
+		delayList_remove(wokenTask);
+		
+		// Timed wait ran out, the task leaves the semaphore or mutex it waited on
+		if(wokenTask->waitList != NULL) {
+			waitCancel(wokenTask);
+			wokenTask->timedOut = true;
+		}
+		
+		// Pends PendSV if the woken task outranks the running one
+		changeState(wokenTask, T_READY);
+		tcbList_enqueue(readyQueue(wokenTask), wokenTask);
+	}
+}
+
+tcbList_t *readyQueue(tcb_t *tcb) {
+	return &scheduler.partitions[tcb->partition].readyQueueList[tcb->priority];
+}
+
+bool partitionEligible(tcb_t *tcb) {
+	return ((tcb->partition == 0) || (tcb->partition == scheduler.activePartition));
+}
+
 osError_t changeState(tcb_t *tcb, taskState_t newState) {
 	
 	taskState_t oldState = tcb->state;
@@ -140,33 +368,213 @@ osError_t changeState(tcb_t *tcb, taskState_t newState) {
 	if(	// Task is running and gets blocked by mutex/semaphore
 			((oldState == T_RUNNING) && (newState == T_BLOCKED)) ||
 			// High priority task is unblocked
-			((oldState == T_BLOCKED) && (newState == T_READY) && (tcb->priority > scheduler.currPriority)) ||
+			((oldState == T_BLOCKED) && (newState == T_READY) && (tcb->priority > scheduler.currPriority) && (partitionEligible(tcb) == true)) ||
 			// New task is created and it is higher priority than the current task
-			((oldState == T_INACTIVE) && (newState == T_READY) && (tcb->priority > scheduler.currPriority))	) {
-		runScheduler = true;
+			((oldState == T_INACTIVE) && (newState == T_READY) && (tcb->priority > scheduler.currPriority) && (partitionEligible(tcb) == true)) ||
+			// Under EDF, a task of the current priority with an earlier deadline becomes ready
+			((scheduler.policy == osPolicyEDF) && ((oldState == T_BLOCKED) || (oldState == T_INACTIVE)) && (newState == T_READY) && 
+			 (tcb->priority == scheduler.currPriority) && (tcb->partition == scheduler.currTCB->partition) && (deadlineBefore(tcb, scheduler.currTCB) == true))	) {
+		// Switch right away instead of at the next tick. From a task, PendSV runs as soon as
+		// interrupts are enabled. From an interrupt handler, it runs once every handler has
+		// returned, since PendSV has the lowest priority
+		#ifdef __DEFER_PREEMPT
+		if(oldState != T_RUNNING) {
+			deferredSwitch = true;
+		}
+		else {
+			triggerScheduler();
+		}
+		#else
+		triggerScheduler();
+		#endif
 	}
-
+	
+	if(newState == T_BLOCKED) {
+		TRACE_EVENT(traceBlock, tcb, 0);
+	}
+	else if(oldState == T_BLOCKED) {
+		TRACE_EVENT(traceUnblock, tcb, newState);
+	}
+	
+	#ifdef __TASK_STATS
+	// Ticks are enough for blocked time, and they do not wrap while a task waits
+	if((newState == T_BLOCKED) && (oldState != T_BLOCKED)) {
+		tcb->blockedSince = msTicks;
+	}
+	else if((oldState == T_BLOCKED) && (newState != T_BLOCKED)) {
+		tcb->blockedTicks += msTicks - tcb->blockedSince;
+	}
+	#endif
+	
 	// Set the new state to the tcb
 	tcb->state = newState;
 	
 	return osNoError;
 }
 
+void setTaskPriority(tcb_t *tcb, priority_t priority) {
+	if(tcb->priority == priority) {
+		return;
+	}
+	
+	// Blocked and table tasks are not in a ready queue, so only the field changes
+	if(((tcb->state != T_READY) && (tcb->state != T_RUNNING)) || (tcb->inTable == true)) {
+		tcb->priority = priority;
+		return;
+	}
+	
+	tcbList_remove(readyQueue(tcb), tcb);
+	tcb->priority = priority;
+	tcbList_enqueue(readyQueue(tcb), tcb);
+	
+	// Running task may no longer be the highest priority, or a ready one may now outrank it
+	if(tcb == scheduler.currTCB) {
+		scheduler.currPriority = priority;
+		triggerScheduler();
+	}
+	else if((priority > scheduler.currPriority) && (partitionEligible(tcb) == true)) {
+		triggerScheduler();
+	}
+}
+
+void setTaskPartition(tcb_t *tcb, uint8_t partition) {
+	if(tcb->partition == partition) {
+		return;
+	}
+	
+	if(((tcb->state != T_READY) && (tcb->state != T_RUNNING)) || (tcb->inTable == true)) {
+		tcb->partition = partition;
+		return;
+	}
+	
+	tcbList_remove(readyQueue(tcb), tcb);
+	tcb->partition = partition;
+	tcbList_enqueue(readyQueue(tcb), tcb);
+	
+	// Running task may have left the open partitions, or a ready one may have joined them
+	if(tcb == scheduler.currTCB) {
+		triggerScheduler();
+	}
+	else if((tcb->priority > scheduler.currPriority) && (partitionEligible(tcb) == true)) {
+		triggerScheduler();
+	}
+}
+
+void triggerScheduler(void) {
+	// Set PENDSV
+	SCB->ICSR |= SET_PENDSV;
+}
+
 void printSchedulerStatus(void) {
-	printf("\nCurrent task: %d, State: %d, Current Priority: %d, [0]: %d, [1]: %d, [2]: %d, [3]: %d\n", 
+	printf("\nCurrent task: %d, State: %d, Current Priority: %d, Active Partition: %d, Ready Bitmaps: 0x%08X 0x%08X\n", 
 				 scheduler.currTCB->tid, 
 				 scheduler.currTCB->state,
 				 scheduler.currTCB->priority,
-				 scheduler.readyQueueList[0].size,
-				 scheduler.readyQueueList[1].size,
-				 scheduler.readyQueueList[2].size,
-				 scheduler.readyQueueList[3].size);
+				 scheduler.activePartition,
+				 scheduler.partitions[0].readyBitmap,
+				 scheduler.partitions[scheduler.activePartition].readyBitmap);
 }
 
-osError_t contextSwitch(tcb_t *oldTCB, tcb_t *newTCB) {
+// Walks a list and counts every task on it. Returns false if it does not hold size tasks
+static bool countListTasks(tcbList_t *list, uint8_t listCount[NUM_TCB]) {
+	tcb_t *currTcb = list->head;
+	tcb_t *lastTcb = NULL;
+	
+	for(uint32_t count = 0; count < list->size; count++) {
+		if((currTcb < &tcb[0]) || (currTcb >= &tcb[NUM_TCB]) || (currTcb->prevTcb != lastTcb)) {
+			return false;
+		}
+		listCount[currTcb - tcb]++;
+		lastTcb = currTcb;
+		currTcb = currTcb->nextTcb;
+	}
 	
-	oldTCB->stackPointer = (uint32_t*)storeContext();
-	restoreContext((uint32_t)newTCB->stackPointer);
+	// Links end at the tail in both directions
+	return (lastTcb == list->tail) && (currTcb == NULL);
+}
+
+static osError_t schedulerFault(const char *reason, tcb_t *task) {
+	printf("Scheduler check failed: %s, TID: %d\n", reason, (task != NULL) ? task->tid : 0);
+	return osError;
+}
+
+osError_t checkSchedulerState(void) {
+	uint8_t listCount[NUM_TCB] = {0};
+	
+	// Ready queues hold ready tasks of their own partition and priority, and the bitmaps match them
+	for(uint32_t partitionIndex = 0; partitionIndex < NUM_PARTITIONS; partitionIndex++) {
+		partition_t *partition = &scheduler.partitions[partitionIndex];
+		
+		for(uint32_t priorityIndex = 0; priorityIndex < NUM_PRIORITIES; priorityIndex++) {
+			tcbList_t *list = &partition->readyQueueList[priorityIndex];
+			uint8_t queueCount[NUM_TCB] = {0};
+			
+			if(countListTasks(list, queueCount) == false) {
+				return schedulerFault("ready queue size does not match its tasks", list->head);
+			}
+			if(((partition->readyBitmap & (1u << priorityIndex)) != 0) != (list->size != 0)) {
+				return schedulerFault("ready bitmap does not match its queue", list->head);
+			}
+			
+			for(uint32_t index = 0; index < NUM_TCB; index++) {
+				if(queueCount[index] == 0) {
+					continue;
+				}
+				if((tcb[index].state != T_READY) && (tcb[index].state != T_RUNNING)) {
+					return schedulerFault("task in a ready queue is not ready", &tcb[index]);
+				}
+				if((tcb[index].priority != priorityIndex) || (tcb[index].partition != partitionIndex)) {
+					return schedulerFault("task is in the ready queue of another priority", &tcb[index]);
+				}
+				listCount[index] += queueCount[index];
+			}
+		}
+	}
+	
+	// Delayed tasks are blocked. A timed wait is on the blocked list it waits on as well, and is
+	// counted there
+	uint32_t delayCount = 0;
+	tcb_t *lastTcb = NULL;
+	for(tcb_t *currTcb = scheduler.delayList; currTcb != NULL; currTcb = currTcb->nextDelay) {
+		if((currTcb->state != T_BLOCKED) || (++delayCount > NUM_TCB)) {
+			return schedulerFault("delay list holds a task that is not blocked", currTcb);
+		}
+		if(currTcb->prevDelay != lastTcb) {
+			return schedulerFault("delay list links do not match", currTcb);
+		}
+		if(currTcb->waitList == NULL) {
+			listCount[currTcb - tcb]++;
+		}
+		lastTcb = currTcb;
+	}
+	
+	// Tasks blocked on a semaphore or mutex are on its list
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		uint8_t waitCount[NUM_TCB] = {0};
+		
+		if(tcb[index].waitList == NULL) {
+			continue;
+		}
+		if((countListTasks(tcb[index].waitList, waitCount) == false) || (waitCount[index] != 1)) {
+			return schedulerFault("task is not on the blocked list it waits on", &tcb[index]);
+		}
+		listCount[index]++;
+	}
+	
+	// Every task is on at most one list, and ready tasks are on one. Table tasks are on none
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		tcb_t *task = &tcb[index];
+		
+		if(listCount[index] > 1) {
+			return schedulerFault("task is on more than one list", task);
+		}
+		if((task->state == T_RUNNING) && (task != scheduler.currTCB)) {
+			return schedulerFault("task is running but is not the current task", task);
+		}
+		if((task->inTable == false) && (task->state == T_READY) && (listCount[index] == 0)) {
+			return schedulerFault("ready task is not in a ready queue", task);
+		}
+	}
 	
 	return osNoError;
 }
@@ -176,57 +584,97 @@ tcbList_t *findNextTask(void) {
 	printf("\nfindNextTask: Enter\n");
 	#endif
 	
-	// Scan through Task List to find Highest Priority
-	priority_t priorityIndex = osPriorityHigh;
-	while(scheduler.readyQueueList[priorityIndex].head == NULL) {
-		priorityIndex--;
+	// Highest set bit of a ready bitmap is the highest priority with a ready task. Only the system
+	// partition and the active one compete. The idle task keeps bit 0 of the system bitmap set,
+	// so it is never empty
+	partition_t *nextPartition = &scheduler.partitions[0];
+	uint32_t activeBitmap = scheduler.partitions[scheduler.activePartition].readyBitmap;
+	
+	// Active partition wins ties, so its tasks run ahead of system tasks of the same priority
+	if((activeBitmap != 0) && (__CLZ(activeBitmap) <= __CLZ(nextPartition->readyBitmap))) {
+		nextPartition = &scheduler.partitions[scheduler.activePartition];
 	}
 	
+	priority_t priorityIndex = (priority_t)(31 - __CLZ(nextPartition->readyBitmap));
+	
 	tcbList_t *nextQueue;
-	nextQueue = &scheduler.readyQueueList[priorityIndex];
+	nextQueue = &nextPartition->readyQueueList[priorityIndex];
 	#ifdef __DEBUG
 	printf("\nfindNextTask: Exit\n");
 	#endif
 	return nextQueue;
 }
 
-void SysTick_Handler(void) {
+#ifdef __TASK_STATS
+// Charges the running task the cycles since the last charge. Called every tick as well as at every
+// switch, so the 32 bit difference never wraps however long a task runs
+static void chargeRunCycles(void) {
+	uint32_t cycles = DWT_CYCCNT;
+	
+	scheduler.currTCB->runCycles += cycles - statsSwitchCycles;
+	statsSwitchCycles = cycles;
+}
+#endif
 
+static void systemTick(void) {
+	
+	#ifdef __TASK_STATS
+	chargeRunCycles();
+	#endif
+	
 	// Increment ms
   msTicks++;
 	// Decrement countDown
 	countDown--;
 	
+	// Wake sleeping tasks
+	delayList_tick();
 	
-	// Check if scheduler is explicitly called
-	if(runScheduler == true) {
-		
-		runScheduler = false;
-		
-		// Reset countdown
-		countDown = timeSlice;
-		// Set PENDSV
-		SCB->ICSR |= SET_PENDSV; 
+	// Wake the timer task if a timer expires on this tick
+	timerTick();
+	
+	#ifdef __DEFER_PREEMPT
+	if(deferredSwitch == true) {
+		deferredSwitch = false;
+		triggerScheduler();
+	}
+	#endif
+	
+	bool switched = false;
+	
+	// Charge the running task, a task that overran its budget is switched out
+	if(budgetTick() == true) {
+		switched = true;
+	}
+	
+	// Start and end schedule table slots. Runs every tick, so slots keep time through overruns
+	if(tableTick() == true) {
+		switched = true;
+	}
+	
+	// Partition statistics, and the switch to the next partition window. Also runs every tick
+	if(partitionTick() == true) {
+		switched = true;
+	}
+	
+	if(switched == true) {
 		return;
 	}
 	
-	// Check if timeslice has ended
-	if(countDown == 0) {
-		// Reset countdown
-		countDown = timeSlice;
-		
+	// Check if timeslice has ended. A table task runs until its slot ends instead
+	if((countDown == 0) && (scheduler.currTCB->inTable == false)) {
 		// Place task that just finished running to back of its queue
 		tcb_t *prevTask;
 		
 		prevTask = scheduler.currTCB;
-		tcbList_t *prevList = &scheduler.readyQueueList[prevTask->priority];
+		tcbList_t *prevList = readyQueue(prevTask);
 		
 		// Change finished task to ready state
 		changeState(prevTask, T_READY);
-
-		tcbList_dequeue(prevList);
+		
+		tcbList_remove(prevList, prevTask);
 		tcbList_enqueue(prevList, prevTask);
-			
+		
 		// Set PENDSV
 		SCB->ICSR |= SET_PENDSV; 
 		
@@ -234,46 +682,304 @@ void SysTick_Handler(void) {
 	}
 }
 
-void PendSV_Handler(void) {
-	printf("\nScheduler: Enter\n");
-	printSchedulerStatus();
+void SysTick_Handler(void) {
+	#if TRACE_SYSTICK
+	TRACE_EVENT(traceIsrEnter, scheduler.currTCB, SYSTICK_EXCEPTION);
+	#endif
+	
+	#ifdef __PROFILE
+	profileTick();
+	#endif
+	
+	systemTick();
+	
+	#if TRACE_SYSTICK
+	TRACE_EVENT(traceIsrExit, scheduler.currTCB, SYSTICK_EXCEPTION);
+	#endif
+}
+
+#ifdef __TICKLESS
+uint32_t nextEventTicks(void) {
+	// Next event is time slice expiry, the first sleeping task waking up, or a timer
+	uint32_t ticks = countDown;
+	
+	if((scheduler.delayList != NULL) && (scheduler.delayList->delayTicks < ticks)) {
+		ticks = scheduler.delayList->delayTicks;
+	}
+	
+	if(ticks > maxIdleTicks) {
+		ticks = maxIdleTicks;
+	}
+	
+	// Software timers that expire or cascade before then, schedule table slots and partition windows
+	ticks = timerNextEvent(ticks);
+	ticks = tableNextEvent(ticks);
+	ticks = partitionNextEvent(ticks);
+	return ticks;
+}
+
+void idleSleep(void) {
+	__disable_irq();
+	
+	// Only suppress ticks when the idle task is the only ready task and no switch is pending
+	if((scheduler.partitions[0].readyBitmap != (1u << osPriorityNone)) || 
+		 (scheduler.partitions[0].readyQueueList[osPriorityNone].size != 1) || 
+		 ((scheduler.activePartition != 0) && (scheduler.partitions[scheduler.activePartition].readyBitmap != 0)) || 
+		 ((SCB->ICSR & SET_PENDSV) != 0)) {
+		__enable_irq();
+		return;
+	}
 	
-	// Create pointer to next task to run
-	tcb_t *prevTask;
-	tcb_t *nextTask;
+	uint32_t idleTicks = nextEventTicks();
+	if(idleTicks < 2) {
+		__enable_irq();
+		return;
+	}
+	
+	// Stop SysTick and program it to fire at the next event. The part of the current tick
+	// that has not elapsed yet is kept so the tick phase does not drift
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	uint32_t sleepReload = SysTick->VAL + (tickReload * (idleTicks - 1));
+	SysTick->LOAD = sleepReload;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	
+	// Interrupts are masked, but a pending interrupt still wakes the core
+	__DSB();
+	__WFI();
+	__ISB();
+	
+	// Reading CTRL clears COUNTFLAG, so read it once
+	uint32_t ctrl = SysTick->CTRL;
+	SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+	
+	uint32_t sleptTicks;
+	if((ctrl & SysTick_CTRL_COUNTFLAG_Msk) != 0) {
+		// Slept until the event. The pending SysTick interrupt accounts for the last tick
+		sleptTicks = idleTicks - 1;
+		SysTick->LOAD = tickReload - 1;
+	}
+	else {
+		// Woken early by another interrupt. Count the whole ticks since the start of the
+		// current tick, then finish the partial one
+		uint32_t elapsed = (idleTicks * tickReload) - SysTick->VAL;
+		sleptTicks = elapsed / tickReload;
+		SysTick->LOAD = ((sleptTicks + 1) * tickReload) - elapsed - 1;
+	}
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	
+	// Normal period applies from the next reload
+	SysTick->LOAD = tickReload - 1;
+	
+	// Correct the tick count for the ticks that were skipped. The sleep never passes the head
+	// of the delay list, so its delta stays above zero
+	msTicks += sleptTicks;
+	countDown -= sleptTicks;
+	if(scheduler.delayList != NULL) {
+		scheduler.delayList->delayTicks -= sleptTicks;
+	}
+	timerSkipTicks(sleptTicks);
+	tableSkipTicks(sleptTicks);
+	partitionSkipTicks(sleptTicks);
+	
+	__enable_irq();
+}
+#endif
+
+uint32_t taskTimeSlice(tcb_t *tcb) {
+	// Task quantum if it has one, otherwise the default of its priority level
+	if(tcb->timeSlice != 0) {
+		return tcb->timeSlice;
+	}
+	return scheduler.timeSlice[tcb->priority];
+}
+
+// Checks a task that is switched out: its saved stack pointer must be inside its stack, and the
+// painted word at the bottom must be intact, or the task has used all of it at some point.
+// Whatever lies below the stack may be corrupted by then, so the kernel halts
+static void checkStack(tcb_t *task) {
+	// Host main() stack is not managed by the kernel
+	if(task->stackOverflowAddress == NULL) {
+		return;
+	}
 	
-	// Store previous task
-	prevTask = scheduler.currTCB;
+	if((task->stackPointer > task->stackOverflowAddress) && (*(task->stackOverflowAddress) == STACK_PAINT)) {
+		return;
+	}
 	
-	// Find next task to run 
-	tcbList_t *nextQueue = findNextTask();
-	nextTask = nextQueue->head;
+	__disable_irq();
+	printf("ERROR: STACK OVERFLOW. TASK ID: %d\n", task->tid);
+	
+	if(stackOverflowHook != NULL) {
+		stackOverflowHook(task->tid);
+	}
+	
+	while(true);
+}
+
+uint32_t *switchTask(uint32_t *stackPointer) {
+	tcb_t *prevTask = scheduler.currTCB;
+	prevTask->stackPointer = stackPointer;
+	
+	// PendSV has saved the registers of a task that just terminated, so its TCB and stack can
+	// be reused from here on
+	if(prevTask->state == T_INACTIVE) {
+		freeTask(prevTask);
+	}
+	else {
+		checkStack(prevTask);
+	}
+	
+	// Preempted task stays in its ready queue
+	if(prevTask->state == T_RUNNING) {
+		changeState(prevTask, T_READY);
+		
+		// Move it behind any task that has an earlier deadline by now
+		if((scheduler.policy == osPolicyEDF) && (prevTask->inTable == false)) {
+			tcbList_t *prevList = readyQueue(prevTask);
+			tcbList_remove(prevList, prevTask);
+			tcbList_enqueue(prevList, prevTask);
+		}
+	}
+	
+	// Task of the current schedule table slot needs no decision
+	tcb_t *nextTask = scheduler.tableTcb;
+	if((nextTask == NULL) || (nextTask->state == T_BLOCKED)) {
+		nextTask = findNextTask()->head;
+	}
+	
+	if(nextTask != prevTask) {
+		TRACE_EVENT(traceSwitchOut, prevTask, prevTask->state);
+		TRACE_EVENT(traceSwitchIn, nextTask, nextTask->priority);
+	}
 	
-	// Context switch between old task and new
-	contextSwitch(prevTask, nextTask);
+	#ifdef __TASK_STATS
+	chargeRunCycles();
+	if(nextTask != prevTask) {
+		nextTask->switches++;
+	}
+	#endif
 	
 	scheduler.currTCB = nextTask;
-	changeState(scheduler.currTCB, T_RUNNING);
-	scheduler.currPriority = scheduler.currTCB->priority;
+	changeState(nextTask, T_RUNNING);
+	scheduler.currPriority = nextTask->priority;
 	
-	// Clear PENDSV
-	SCB->ICSR |= (CLEAR_PENDSV);
+	// Start a fresh time slice
+	countDown = taskTimeSlice(nextTask);
 	
-	printSchedulerStatus();
-	printf("\nScheduler: Exit\n");
+	return nextTask->stackPointer;
+}
+
+#ifdef __SWITCH_BENCH
+void switchBenchRecord(void) {
+	uint32_t cycles = DWT_CYCCNT - switchEntryCycles;
+	
+	if(cycles < switchMinCycles) {
+		switchMinCycles = cycles;
+	}
+	if(cycles > switchMaxCycles) {
+		switchMaxCycles = cycles;
+	}
+	switchTotalCycles += cycles;
+	switchCount++;
 }
 
+void printSwitchStats(void) {
+	if(switchCount == 0) {
+		printf("Context switch: no samples\n");
+		return;
+	}
+	
+	printf("Context switch: %d samples, min %d, mean %d, max %d cycles\n",
+				 switchCount,
+				 switchMinCycles,
+				 (uint32_t)(switchTotalCycles / switchCount),
+				 switchMaxCycles);
+}
+
+void resetSwitchStats(void) {
+	__disable_irq();
+	switchMinCycles = UINT32_MAX;
+	switchMaxCycles = 0;
+	switchTotalCycles = 0;
+	switchCount = 0;
+	__enable_irq();
+}
+#endif
+
+#ifdef __TASK_STATS
+void readTaskStats(tcb_t *task, osTaskStats_t *stats) {
+	stats->runCycles = task->runCycles;
+	stats->switches = task->switches;
+	stats->blockedTicks = task->blockedTicks;
+	
+	// Add the run or block still going on
+	if(task == scheduler.currTCB) {
+		stats->runCycles += DWT_CYCCNT - statsSwitchCycles;
+	}
+	else if(task->state == T_BLOCKED) {
+		stats->blockedTicks += msTicks - task->blockedSince;
+	}
+}
+#endif
+
 void initScheduler(void) {
 	tcb[0].tid = IDLE_ID;
 	tcb[0].state = T_RUNNING;
 	
 	scheduler.currTCB = &tcb[0];
 	scheduler.currPriority = osPriorityNone;
-	scheduler.readyQueueList[osPriorityNone].size = 1;
-	scheduler.readyQueueList[osPriorityNone].head = &tcb[0];
-	scheduler.readyQueueList[osPriorityNone].tail = &tcb[0];
+	scheduler.activePartition = 0;
+	scheduler.delayList = NULL;
+	scheduler.policy = osPolicyFixed;
+	scheduler.tableTcb = NULL;
+	
+	for(uint32_t partitionIndex = 0; partitionIndex < NUM_PARTITIONS; partitionIndex++) {
+		partition_t *partition = &scheduler.partitions[partitionIndex];
+		partition->readyBitmap = 0;
+		partition->windowTicks = 0;
+		partition->runTicks = 0;
+		
+		for(uint32_t priorityIndex = 0; priorityIndex < NUM_PRIORITIES; priorityIndex++) {
+			partition->readyQueueList[priorityIndex].size = 0;
+			partition->readyQueueList[priorityIndex].head = NULL;
+			partition->readyQueueList[priorityIndex].tail = NULL;
+			partition->readyQueueList[priorityIndex].readyBitmap = &partition->readyBitmap;
+			partition->readyQueueList[priorityIndex].readyMask = 1u << priorityIndex;
+		}
+	}
+	
+	for(uint32_t priorityIndex = 0; priorityIndex < NUM_PRIORITIES; priorityIndex++) {
+		scheduler.timeSlice[priorityIndex] = STIME;
+	}
+	
+	tcb[0].partition = 0;
+	tcbList_enqueue(readyQueue(&tcb[0]), &tcb[0]);
 	
-	scheduler.readyQueueList[osPriorityLow].size = 0;
-	scheduler.readyQueueList[osPriorityMed].size = 0;
-	scheduler.readyQueueList[osPriorityHigh].size = 0;
+	#ifdef __SWITCH_BENCH
+	// Start the cycle counter
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	#endif
+	
+	#ifdef __TASK_STATS
+	// Start the cycle counter, main() runs from here on
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	statsSwitchCycles = DWT_CYCCNT;
+	#endif
+	
+	#ifdef __LOCK_STATS
+	// Wait and hold times are measured with the cycle counter
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	#endif
+	
+	#ifdef __TICKLESS
+	// SysTick has been configured by osInitialize
+	tickReload = SysTick->LOAD + 1;
+	maxIdleTicks = SysTick_LOAD_RELOAD_Msk / tickReload;
+	#endif
 }
@@ -16,6 +16,16 @@
 
 #include "context.h"
 #include "global_types.h"
+#include "trace.h"
+#include "profile.h"
+
+// DWT cycle counter registers
+#ifndef DWT_CYCCNT
+#define DWT_CTRL		(*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT	(*(volatile uint32_t *)0xE0001004)
+#endif
+#define DWT_CTRL_CYCCNTENA	(1 << 0)
+#define DEMCR_TRCENA				(1 << 24)
 
 /**********************************************TCB METHODS*************************************************/
 
@@ -25,25 +35,81 @@ void printTcbContents(tcb_t *tcb);
 void printListContents(tcbList_t *list);
 void printSchedulerStatus(void);
 
+// Consistency check of the ready queues, delay list and blocked lists against the task states.
+// Prints the first broken invariant and returns osError. Called with interrupts disabled
+osError_t checkSchedulerState(void);
+
 // TCB stack methods
 osError_t tcb_push(tcb_t *tcb, uint32_t content);
 
-// TCB list queueing methods
+// TCB list queueing methods. Lists are doubly linked through the TCBs, so tcbList_remove takes any
+// task off the list it is on in constant time. A task is on one list at a time, as they share the links
+bool deadlineBefore(tcb_t *tcb, tcb_t *otherTcb);
 osError_t tcbList_enqueue(tcbList_t *list, tcb_t* tcb);
 tcb_t *tcbList_dequeue(tcbList_t *list);
+osError_t tcbList_remove(tcbList_t *list, tcb_t *tcb);
+
+// Delay list methods. The delay list has links of its own, so a task in a timed wait is on it and
+// on a blocked list at once. delayList_remove is constant time and returns osErrorInv if the task
+// is not on it. A task woken by delayList_tick while on a blocked list leaves it with timedOut set
+void delayList_insert(tcb_t *tcb, uint32_t ticks);
+osError_t delayList_remove(tcb_t *tcb);
+void delayList_tick(void);
 
 // TCB state changing method. Detects if scheduler needs to be run
 osError_t changeState(tcb_t *tcb, taskState_t newState);
+
+// Ready queue of a task in its partition, and whether its partition may run now
+tcbList_t *readyQueue(tcb_t *tcb);
+bool partitionEligible(tcb_t *tcb);
+
+// Reorders every ready queue for the current policy, the running task stays at its head
+void sortReadyQueues(void);
+
+// Move a task between ready queues when its priority or partition changes. Called with interrupts disabled
+void setTaskPriority(tcb_t *tcb, priority_t priority);
+void setTaskPartition(tcb_t *tcb, uint8_t partition);
+
+// Pends a context switch, taken as soon as interrupts are enabled
+void triggerScheduler(void);
+
+// Finds the TCB of a live task, NULL if the ID is invalid, names the idle task or the task has
+// terminated. In ezOS.c
+tcb_t *findTask(tid_t tid);
+
+// Returns the TCB and pool stack of a terminated task to the free lists, in ezOS.c. Called with
+// interrupts disabled, once the task's registers have been saved
+void freeTask(tcb_t *task);
 /**********************************************TCB METHODS*************************************************/
 
-// Context switch methods
-osError_t contextSwitch(tcb_t *oldTCB, tcb_t *newTCB);
+// Context switch methods. switchTask is called by PendSV_Handler with the stack pointer of
+// the outgoing task and returns the stack pointer of the incoming one
+uint32_t *switchTask(uint32_t *stackPointer);
+uint32_t taskTimeSlice(tcb_t *tcb);
 tcbList_t *findNextTask(void);
 
+#ifdef __SWITCH_BENCH
+// Context switch benchmark methods
+extern uint32_t switchEntryCycles;
+void switchBenchRecord(void);
+void printSwitchStats(void);
+void resetSwitchStats(void);
+#endif
+
+#ifdef __TASK_STATS
+// Run time statistics of a task, the current run or block included. Called with interrupts disabled
+void readTaskStats(tcb_t *task, osTaskStats_t *stats);
+#endif
+
 // ISR's
-void PendSV_Handler(void);
 void SysTick_Handler(void);
 
+#ifdef __TICKLESS
+// Tickless idle methods. Only called from the idle task
+uint32_t nextEventTicks(void);
+void idleSleep(void);
+#endif
+
 // Scheduler initialize method. Sets ready queues to blank lists
 void initScheduler(void);
 
@@ -0,0 +1,196 @@
+/*
+
+	Source file for the UART shell. A low priority task reads commands from the Retarget UART and
+	prints the run time statistics of every task, so a running system shows which task uses the CPU
+	
+	Author: Boris Kim
+
+*/
+
+#include <string.h>
+
+#include "shell.h"
+#include "ezOS.h"
+
+#ifdef __TASK_STATS
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern tcb_t tcb[NUM_TCB];
+
+// Run cycles of every TCB at the last top refresh. A TCB reused by a new task has a different ID
+static uint64_t lastRunCycles[NUM_TCB];
+static tid_t lastTid[NUM_TCB];
+
+// Snapshot taken by a top refresh. Kept off the shell stack, which would need to grow with NUM_TCB
+static osTaskStats_t topStats[NUM_TCB];
+static tid_t topTids[NUM_TCB];
+static taskState_t topStates[NUM_TCB];
+static priority_t topPriorities[NUM_TCB];
+static uint32_t topRunDelta[NUM_TCB];
+
+static bool shellStarted = false;
+
+static const char *stateNames[] = {"inactive", "ready", "running", "blocked"};
+/**********************************************GLOBAL VARIABLES********************************************/
+
+static void shellPrompt(void) {
+	printf("ezOS> ");
+}
+
+// Takes a waiting character, if any. Line ends are left to the line reader
+static bool shellKeyPressed(void) {
+	while(UARTCharReady(SHELL_PORT) != 0) {
+		uint8_t character = UARTReceiveChar(SHELL_PORT);
+		if((character != '\r') && (character != '\n')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void shellTopRefresh(void) {
+	uint32_t totalDelta = 0;
+	
+	// One snapshot of every task, so the shares add up
+	__disable_irq();
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		topTids[index] = tcb[index].tid;
+		topStates[index] = tcb[index].state;
+		topPriorities[index] = tcb[index].priority;
+		if(topStates[index] == T_INACTIVE) {
+			continue;
+		}
+		readTaskStats(&tcb[index], &topStats[index]);
+	}
+	__enable_irq();
+	
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		topRunDelta[index] = 0;
+		if(topStates[index] == T_INACTIVE) {
+			continue;
+		}
+		
+		uint64_t previous = (lastTid[index] == topTids[index]) ? lastRunCycles[index] : 0;
+		topRunDelta[index] = (uint32_t)(topStats[index].runCycles - previous);
+		totalDelta += topRunDelta[index];
+		
+		lastRunCycles[index] = topStats[index].runCycles;
+		lastTid[index] = topTids[index];
+	}
+	
+	printf("\n  TID PRI STATE      CPU%%   SWITCHES  BLOCKED ms\n");
+	for(uint32_t index = 0; index < NUM_TCB; index++) {
+		if(topStates[index] == T_INACTIVE) {
+			continue;
+		}
+		
+		uint32_t permille = (totalDelta != 0) ? (uint32_t)(((uint64_t)topRunDelta[index] * 1000) / totalDelta) : 0;
+		printf("%5d %3d %-8s %3d.%d %10d %11d\n", topTids[index], topPriorities[index], stateNames[topStates[index]],
+			permille / 10, permille % 10, topStats[index].switches, topStats[index].blockedTicks);
+	}
+}
+
+static void shellTop(void) {
+	printf("Press a key to stop\n");
+	
+	// First refresh only sets the baseline
+	shellTopRefresh();
+	
+	while(true) {
+		for(uint32_t ticks = 0; ticks < SHELL_REFRESH_PERIOD; ticks += SHELL_POLL_PERIOD) {
+			if(shellKeyPressed() == true) {
+				return;
+			}
+			osDelay(SHELL_POLL_PERIOD);
+		}
+		shellTopRefresh();
+	}
+}
+
+static void shellExecute(const char *line) {
+	if(strcmp(line, "top") == 0) {
+		shellTop();
+	}
+	#ifdef __PROFILE
+	else if(strcmp(line, "profile") == 0) {
+		osProfileDump();
+	}
+	#endif
+	#ifdef __LOCK_STATS
+	else if(strcmp(line, "locks") == 0) {
+		osLockStatsDump();
+	}
+	#endif
+	else if(strcmp(line, "help") == 0) {
+		printf("help    list the commands\n");
+		printf("top     CPU usage, switches and blocked time of every task, until a key is pressed\n");
+		#ifdef __PROFILE
+		printf("profile PC histograms of every task, for tools/profile_symbolize.py\n");
+		#endif
+		#ifdef __LOCK_STATS
+		printf("locks   acquisitions, contention, wait and hold times of every semaphore and mutex\n");
+		#endif
+	}
+	else {
+		printf("Unknown command: %s\n", line);
+	}
+}
+
+static void shellTask(void *argument) {
+	char line[SHELL_LINE_LENGTH + 1];
+	uint32_t length = 0;
+	
+	shellPrompt();
+	
+	while(true) {
+		if(UARTCharReady(SHELL_PORT) == 0) {
+			osDelay(SHELL_POLL_PERIOD);
+			continue;
+		}
+		
+		uint8_t character = UARTReceiveChar(SHELL_PORT);
+		
+		if((character == '\r') || (character == '\n')) {
+			// CR LF, or a line with nothing on it
+			if(length == 0) {
+				continue;
+			}
+			#if SHELL_ECHO
+			printf("\n");
+			#endif
+			
+			line[length] = '\0';
+			length = 0;
+			shellExecute(line);
+			shellPrompt();
+		}
+		else if((character == '\b') || (character == 0x7F)) {
+			if(length > 0) {
+				length--;
+				#if SHELL_ECHO
+				printf("\b \b");
+				#endif
+			}
+		}
+		else if(length < SHELL_LINE_LENGTH) {
+			line[length++] = character;
+			#if SHELL_ECHO
+			printf("%c", character);
+			#endif
+		}
+	}
+}
+
+osError_t osShellStart(void) {
+	if(shellStarted == true) {
+		return osErrorInv;
+	}
+	
+	osError_t error = osCreateTask(shellTask, NULL, SHELL_PRIORITY, SHELL_STACK_SIZE, NULL);
+	if(error == osNoError) {
+		shellStarted = true;
+	}
+	return error;
+}
+
+#endif
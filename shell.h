@@ -0,0 +1,51 @@
+/*
+
+	Header file for the UART shell
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __SHELL_H
+#define __SHELL_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "global_types.h"
+
+// UART the shell reads commands from. printf, which the shell answers with, goes to the same port
+#define SHELL_PORT 0
+
+// Shell task runs above the idle task only, so it takes no time from the application
+#define SHELL_PRIORITY osPriorityLow
+#ifndef SHELL_STACK_SIZE
+#define SHELL_STACK_SIZE DEFAULT_STACK_SIZE
+#endif
+
+// Ticks between polls of the UART while no character is waiting
+#define SHELL_POLL_PERIOD 20
+
+// Ticks every top refresh measures CPU usage over
+#define SHELL_REFRESH_PERIOD TICK_RATE_HZ
+
+// Longest command, and whether typed characters are echoed back. A terminal in line mode echoes
+// them itself
+#define SHELL_LINE_LENGTH 32
+#ifndef SHELL_ECHO
+#define SHELL_ECHO 1
+#endif
+
+#ifdef __TASK_STATS
+// Starts the shell task. Commands:
+//   help	lists the commands
+//   top		prints the CPU usage, context switches and blocked time of every task every
+//				SHELL_REFRESH_PERIOD ticks, until a key is pressed
+//   profile	prints the PC histograms of osProfileDump, with __PROFILE
+//   locks	prints the lock statistics of osLockStatsDump, with __LOCK_STATS
+osError_t osShellStart(void);
+#endif
+
+#endif //__SHELL_H
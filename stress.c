@@ -0,0 +1,328 @@
+/*
+
+	Source file for the randomized scheduler stress test. Worker tasks mix semaphore lends and
+	returns, mutex contention, timed waits, yields, delays and busy loops at random while the
+	controller changes their priorities. The scheduler invariants are checked on every tick and
+	after every operation
+	
+	Author: Boris Kim
+
+*/
+
+#include "stress.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+// Global TCBs, worker priorities are changed on them directly
+extern scheduler_t scheduler;
+extern tcb_t tcb[NUM_TCB];
+
+// Objects the workers contend on. Every worker locks every mutex, so a mutex can have several waiters
+static sem_t stressSems[STRESS_SEMAPHORES];
+static mutex_t stressMutexes[STRESS_MUTEXES];
+
+// Lends every worker holds on every semaphore. The semaphores are binary, so a semaphore is held
+// by at most one worker. Shared with the controller, which moves a lend to break a deadlock
+static volatile uint32_t stressHeld[STRESS_TASKS][STRESS_SEMAPHORES];
+static tcb_t *stressWorkers[STRESS_TASKS];
+
+// Cleared once the test is over, workers give back what they hold and exit
+static volatile bool stressRunning;
+static volatile uint32_t stressFinished;
+
+// Operations completed by the workers, mutexes that were not owned by the task that locked them,
+// and timed waits that ran out
+static volatile uint32_t stressOps;
+static volatile uint32_t mutexViolations;
+static volatile uint32_t stressTimeouts;
+
+// Deadlocks the controller broke, and the first broken invariant a worker found
+static uint32_t stressDeadlocks;
+static volatile osError_t workerResult;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+typedef enum {
+	stressLend = 0,
+	stressReturn,
+	stressMutex,
+	stressYield,
+	stressDelay,
+	stressBusy,
+	STRESS_OPERATIONS
+} stressOperation_t;
+
+// xorshift32, enough to spread the operations and cheap enough not to dominate them
+static uint32_t stressRandom(uint32_t *state) {
+	uint32_t value = *state;
+	
+	value ^= value << 13;
+	value ^= value >> 17;
+	value ^= value << 5;
+	
+	*state = value;
+	return value;
+}
+
+static void stressReport(const char *result, uint32_t value, const char *unit) {
+	printf("STRESS %s %d %s\n", result, value, unit);
+}
+
+static void stressBusyLoop(uint32_t loops) {
+	for(volatile uint32_t loop = 0; loop < loops; loop++);
+}
+
+static void stressWorker(void *argument) {
+	uint32_t index = (uint32_t)(uintptr_t)argument;
+	uint32_t random = (STRESS_SEED * 2654435761u) + index + 1;
+	volatile uint32_t *held = stressHeld[index];
+	
+	while(stressRunning == true) {
+		uint32_t value = stressRandom(&random);
+		uint32_t semIndex = (value >> 8) % STRESS_SEMAPHORES;
+		mutex_t *mutex = &stressMutexes[(value >> 24) % STRESS_MUTEXES];
+		
+		switch((stressOperation_t)(value % STRESS_OPERATIONS)) {
+			case stressLend :
+				// Some waits are timed, a wait that runs out has no count to give back
+				if((value & (1 << 13)) != 0) {
+					if(osSemaphoreLendTimeout(&stressSems[semIndex], 1 + ((value >> 14) & 3)) != osNoError) {
+						stressTimeouts++;
+						break;
+					}
+				}
+				else {
+					osSemaphoreLend(&stressSems[semIndex]);
+				}
+				held[semIndex]++;
+				break;
+			
+			case stressReturn :
+				if(held[semIndex] > 0) {
+					held[semIndex]--;
+					osSemaphoreReturn(&stressSems[semIndex]);
+				}
+				break;
+			
+			case stressMutex :
+				if((value & (1 << 13)) != 0) {
+					if(osMutexLockTimeout(mutex, 1 + ((value >> 14) & 3)) != osNoError) {
+						stressTimeouts++;
+						break;
+					}
+				}
+				else {
+					osMutexLock(mutex);
+				}
+				if(mutex->owner->tid != osTaskSelf()) {
+					mutexViolations++;
+				}
+				stressBusyLoop((value >> 16) & 0xFF);
+				if((value & (1 << 12)) != 0) {
+					osYield();
+				}
+				osMutexUnlock(mutex);
+				break;
+			
+			case stressYield :
+				osYield();
+				break;
+			
+			case stressDelay :
+				osDelay(1 + ((value >> 16) & 1));
+				break;
+			
+			default :
+				stressBusyLoop((value >> 16) & 0x3FF);
+				break;
+		}
+		stressOps++;
+		
+		__disable_irq();
+		osError_t result = checkSchedulerState();
+		if(result != osNoError) {
+			workerResult = result;
+		}
+		__enable_irq();
+	}
+	
+	for(uint32_t semIndex = 0; semIndex < STRESS_SEMAPHORES; semIndex++) {
+		while(held[semIndex] > 0) {
+			held[semIndex]--;
+			osSemaphoreReturn(&stressSems[semIndex]);
+		}
+	}
+	
+	__disable_irq();
+	stressFinished++;
+	__enable_irq();
+}
+
+// Worker holding a semaphore, or STRESS_TASKS if none has recorded the lend yet
+static uint32_t stressHolder(uint32_t semIndex) {
+	for(uint32_t index = 0; index < STRESS_TASKS; index++) {
+		if(stressHeld[index][semIndex] != 0) {
+			return index;
+		}
+	}
+	return STRESS_TASKS;
+}
+
+// Semaphore a worker waits on without a timeout, or STRESS_SEMAPHORES if it can still make progress
+static uint32_t stressWaitingOn(tcb_t *worker) {
+	// A timed wait runs out by itself
+	if((worker->state != T_BLOCKED) || (worker->prevDelay != NULL) || (scheduler.delayList == worker)) {
+		return STRESS_SEMAPHORES;
+	}
+	
+	for(uint32_t semIndex = 0; semIndex < STRESS_SEMAPHORES; semIndex++) {
+		if(worker->waitList == &stressSems[semIndex].blockedList) {
+			return semIndex;
+		}
+	}
+	return STRESS_SEMAPHORES;
+}
+
+// Breaks deadlocks among the workers. Follows every taken semaphore to its holder, and on to the
+// semaphore that holder waits on. If the chain comes back around, every worker in it waits for
+// ever, and the holder of the first semaphore gives its lend to the first waiter. Counts are only
+// moved, never made up, so the semaphores stay binary
+static void stressUnblock(void) {
+	__disable_irq();
+	
+	for(uint32_t semIndex = 0; semIndex < STRESS_SEMAPHORES; semIndex++) {
+		if(stressSems[semIndex].blockedList.size == 0) {
+			continue;
+		}
+		
+		uint32_t chainSem = semIndex;
+		uint32_t holder = STRESS_TASKS;
+		for(uint32_t step = 0; step < STRESS_SEMAPHORES; step++) {
+			holder = stressHolder(chainSem);
+			if(holder == STRESS_TASKS) {
+				break;
+			}
+			chainSem = stressWaitingOn(stressWorkers[holder]);
+			if((chainSem == STRESS_SEMAPHORES) || (chainSem == semIndex)) {
+				break;
+			}
+		}
+		
+		if((holder != STRESS_TASKS) && (chainSem == semIndex)) {
+			holder = stressHolder(semIndex);
+			stressHeld[holder][semIndex]--;
+			stressDeadlocks++;
+			osSemaphoreReturn(&stressSems[semIndex]);
+		}
+	}
+	
+	__enable_irq();
+}
+
+osError_t stressRun(uint32_t ticks) {
+	tid_t workerTids[STRESS_TASKS];
+	uint32_t random = STRESS_SEED;
+	uint32_t checks = 0;
+	osError_t result = osNoError;
+	
+	for(uint32_t semIndex = 0; semIndex < STRESS_SEMAPHORES; semIndex++) {
+		osSemaphoreInit(&stressSems[semIndex], 1);
+		for(uint32_t index = 0; index < STRESS_TASKS; index++) {
+			stressHeld[index][semIndex] = 0;
+		}
+	}
+	for(uint32_t mutexIndex = 0; mutexIndex < STRESS_MUTEXES; mutexIndex++) {
+		osMutexInit(&stressMutexes[mutexIndex]);
+	}
+	
+	stressOps = 0;
+	mutexViolations = 0;
+	stressTimeouts = 0;
+	stressDeadlocks = 0;
+	workerResult = osNoError;
+	stressFinished = 0;
+	stressRunning = true;
+	
+	for(uint32_t index = 0; index < STRESS_TASKS; index++) {
+		osError_t error = osCreateTask(stressWorker, (void*)(uintptr_t)index, osPriorityLow + (index % 3), STRESS_STACK_SIZE, &workerTids[index]);
+		if(error != osNoError) {
+			osPrintError(error);
+			return error;
+		}
+		stressWorkers[index] = &tcb[workerTids[index] & TID_INDEX_MASK];
+	}
+	
+	stressReport("seed", STRESS_SEED, "-");
+	
+	uint32_t startTick = osGetTickCount();
+	while((osGetTickCount() - startTick) < ticks) {
+		uint32_t value = stressRandom(&random);
+		tcb_t *worker = &tcb[workerTids[value % STRESS_TASKS] & TID_INDEX_MASK];
+		
+		__disable_irq();
+		result = checkSchedulerState();
+		if(result == osNoError) {
+			result = workerResult;
+		}
+		if(result == osNoError) {
+			setTaskPriority(worker, (priority_t)(osPriorityLow + ((value >> 8) % 3)));
+		}
+		__enable_irq();
+		
+		if(result != osNoError) {
+			break;
+		}
+		checks++;
+		
+		stressUnblock();
+		osDelay(1);
+	}
+	uint32_t ops = stressOps;
+	uint32_t elapsed = osGetTickCount() - startTick;
+	
+	stressReport("operations", ops, "ops");
+	stressReport("throughput", (uint32_t)(((uint64_t)ops * TICK_RATE_HZ) / elapsed), "ops/s");
+	stressReport("checks", checks, "checks");
+	stressReport("mutex_violations", mutexViolations, "locks");
+	stressReport("timeouts", stressTimeouts, "waits");
+	stressReport("deadlocks", stressDeadlocks, "broken");
+	
+	if((result == osNoError) && (mutexViolations != 0)) {
+		result = osError;
+	}
+	
+	// Kernel state can not be trusted any more, the workers are left where they are
+	if(result != osNoError) {
+		stressReport("result", 1, "fail");
+		return result;
+	}
+	
+	// Keep releasing blocked workers until all of them have exited
+	stressRunning = false;
+	while(stressFinished < STRESS_TASKS) {
+		stressUnblock();
+		osDelay(1);
+	}
+	for(uint32_t index = 0; index < STRESS_TASKS; index++) {
+		osTaskJoin(workerTids[index]);
+	}
+	
+	// Every lend has been given back, so every semaphore is back to its single count
+	for(uint32_t semIndex = 0; semIndex < STRESS_SEMAPHORES; semIndex++) {
+		if(stressSems[semIndex].count != 1) {
+			stressReport("semaphore_count", stressSems[semIndex].count, "counts");
+			result = osError;
+		}
+	}
+	
+	if((result == osNoError) && (workerResult != osNoError)) {
+		result = workerResult;
+	}
+	
+	if(result != osNoError) {
+		stressReport("result", 1, "fail");
+		return result;
+	}
+	
+	stressReport("result", 0, "pass");
+	return osNoError;
+}
@@ -0,0 +1,54 @@
+/*
+
+	Header file for the randomized scheduler stress test
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __STRESS_H
+#define __STRESS_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "global_types.h"
+
+// Number of worker tasks. The controller and the idle task need two more TCBs
+#ifndef STRESS_TASKS
+#define STRESS_TASKS (NUM_TCB - 2)
+#endif
+
+#if (STRESS_TASKS < 2) || (STRESS_TASKS > (NUM_TCB - 2))
+#error "STRESS_TASKS must be at least 2 and leave two TCBs free"
+#endif
+
+// Semaphores the workers lend and return at random
+#define STRESS_SEMAPHORES 2
+
+// Mutexes the workers lock at random. Fewer mutexes than workers, so they queue up on them
+#define STRESS_MUTEXES 2
+
+// Seed of the random sequences. The same seed gives every task the same sequence of operations
+#ifndef STRESS_SEED
+#define STRESS_SEED 1
+#endif
+
+// Stack of every worker task
+#ifndef STRESS_STACK_SIZE
+#define STRESS_STACK_SIZE (DEFAULT_STACK_SIZE / 2)
+#endif
+
+// Priority of the task running the test. Workers run below it
+#define STRESS_PRIORITY (osPriorityMax - 1)
+
+// Runs the stress test for the given number of ticks from the calling task, which should run at
+// STRESS_PRIORITY. Every tick the controller checks the scheduler invariants, changes the priority
+// of a random worker and breaks any deadlock among workers holding each other's semaphores. Workers
+// check the invariants after every operation. Prints "STRESS <result> <value> <unit>" lines and
+// returns osError on the first broken invariant, or if a semaphore count was lost or made up
+osError_t stressRun(uint32_t ticks);
+
+#endif //__STRESS_H
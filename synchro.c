@@ -9,17 +9,78 @@
 #include "synchro.h"
 
 /**********************************************GLOBAL VARIABLES********************************************/
-// Boolean to determine early pre-empting
-extern bool runScheduler;
-
 // Global scheduler
 extern scheduler_t scheduler;
 
 // TCB's
 extern tcb_t tcb[NUM_TCB];
 extern tcb_t main_tcb;
+
+#ifdef __LOCK_STATS
+// Every semaphore and mutex that has been initialized, linked through stats.nextLock
+static osLockStats_t *lockRegistry = NULL;
+#endif
 /**********************************************GLOBAL VARIABLES********************************************/
 
+#ifdef __LOCK_STATS
+// Clears the statistics and adds the object to the registry, unless it is initialized again
+static void lockStatsInit(osLockStats_t *stats, osLockType_t type) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	bool registered = false;
+	for(osLockStats_t *lock = lockRegistry; lock != NULL; lock = lock->nextLock) {
+		if(lock == stats) {
+			registered = true;
+			break;
+		}
+	}
+	
+	void *nextLock = registered ? stats->nextLock : lockRegistry;
+	*stats = (osLockStats_t){0};
+	stats->nextLock = nextLock;
+	stats->type = type;
+	if(registered == false) {
+		lockRegistry = stats;
+	}
+	
+	__set_PRIMASK(primask);
+}
+
+// Called with interrupts disabled when task gets the lock. A contended task has waited since waitStart
+static void lockStatsAcquired(osLockStats_t *stats, tcb_t *task, bool contended) {
+	stats->acquisitions++;
+	if(contended == true) {
+		uint32_t wait = DWT_CYCCNT - task->waitStart;
+		stats->contended++;
+		stats->totalWait += wait;
+		if(wait > stats->maxWait) {
+			stats->maxWait = wait;
+		}
+	}
+}
+
+// Called with interrupts disabled when the lock becomes unavailable
+static void lockStatsHeld(osLockStats_t *stats) {
+	stats->holdStart = DWT_CYCCNT;
+	stats->held = true;
+}
+
+// Called with interrupts disabled when the lock is given back
+static void lockStatsReleased(osLockStats_t *stats) {
+	if(stats->held == false) {
+		return;
+	}
+	
+	uint32_t hold = DWT_CYCCNT - stats->holdStart;
+	stats->totalHold += hold;
+	if(hold > stats->maxHold) {
+		stats->maxHold = hold;
+	}
+	stats->held = false;
+}
+#endif
+
 void osSemaphoreInit(sem_t *sem, uint32_t count) {
 	sem->count = count;
 	
@@ -27,59 +88,222 @@ void osSemaphoreInit(sem_t *sem, uint32_t count) {
 	blankList.size = 0;
 	blankList.head = NULL;
 	blankList.tail = NULL;
+	blankList.readyBitmap = NULL;
+	blankList.readyMask = 0;
 	
 	sem->blockedList = blankList;
+	
+	#ifdef __LOCK_STATS
+	lockStatsInit(&sem->stats, osLockSemaphore);
+	#endif
+}
+
+// Moves the running task from its ready queue to a blocked list and switches it out as soon as
+// interrupts are enabled. Unless it waits forever, the task is put on the delay list as well, and
+// leaves the blocked list with timedOut set if it is still there after ticks. Called with
+// interrupts disabled
+static void blockCurrentTask(tcbList_t *blockedList, uint32_t ticks) {
+	tcb_t *blockTask = scheduler.currTCB;
+	
+	#ifdef __LOCK_STATS
+	blockTask->waitStart = DWT_CYCCNT;
+	#endif
+	
+	changeState(blockTask, T_BLOCKED);
+	
+	// Links are shared by every list, so the task leaves its ready queue first
+	tcbList_remove(readyQueue(blockTask), blockTask);
+	tcbList_enqueue(blockedList, blockTask);
+	blockTask->waitList = blockedList;
+	
+	blockTask->timedOut = false;
+	if(ticks != OS_WAIT_FOREVER) {
+		delayList_insert(blockTask, ticks);
+	}
+	
+	triggerScheduler();
+}
+
+// Takes a task handed a semaphore count or a mutex off its blocked list and the delay list of a
+// timed wait, and makes it ready. Called with interrupts disabled
+static void wakeBlockedTask(tcbList_t *blockedList, tcb_t *wakeTask) {
+	tcbList_remove(blockedList, wakeTask);
+	delayList_remove(wakeTask);
+	wakeTask->waitList = NULL;
+	wakeTask->waitMutex = NULL;
+	
+	changeState(wakeTask, T_READY);
+	tcbList_enqueue(readyQueue(wakeTask), wakeTask);
 }
 
 osError_t osSemaphoreLend(sem_t *sem) {
+	return osSemaphoreLendTimeout(sem, OS_WAIT_FOREVER);
+}
+
+osError_t osSemaphoreLendTimeout(sem_t *sem, uint32_t ticks) {
 	__disable_irq();
+	#ifdef __DEBUG
 	printf("Semaphore lend enter, Semaphore count: %d\n", sem->count);
+	#endif
 	if(sem->count <= 0) {
-		// Change state of current task to blocked
-		changeState(scheduler.currTCB, T_BLOCKED);
-		tcbList_enqueue(&sem->blockedList, scheduler.currTCB);
-		tcbList_dequeue(&scheduler.readyQueueList[scheduler.currPriority]);
+		if(ticks == 0) {
+			#ifdef __LOCK_STATS
+			sem->stats.timeouts++;
+			#endif
+			__enable_irq();
+			return osErrorTimeout;
+		}
 		
-		printf("Was blocked. Semaphore count: %d\n", sem->count);
-		while(sem->count <= 0) {
+		// Idle task has to stay ready, it can only try without waiting
+		if(scheduler.currTCB == &tcb[0]) {
 			__enable_irq();
-			while(runScheduler == true) {
-				printf("");
-			}
-			__disable_irq();
+			return osErrorPerm;
+		}
+		
+		blockCurrentTask(&sem->blockedList, ticks);
+		
+		// Task is switched out here. osSemaphoreReturn hands its count straight to this task
+		// before making it ready, so only the timeout is left to check
+		__enable_irq();
+		__disable_irq();
+		
+		#ifdef __DEBUG
+		printf("Was blocked. Semaphore count: %d\n", sem->count);
+		#endif
+		
+		osError_t result = osNoError;
+		if(scheduler.currTCB->timedOut == true) {
+			#ifdef __LOCK_STATS
+			sem->stats.timeouts++;
+			#endif
+			result = osErrorTimeout;
 		}
+		__enable_irq();
+		return result;
 	}
 	
 	(sem->count)--;
+	TRACE_EVENT(traceSemLend, scheduler.currTCB, sem);
+	
+	#ifdef __LOCK_STATS
+	lockStatsAcquired(&sem->stats, scheduler.currTCB, false);
+	if(sem->count == 0) {
+		lockStatsHeld(&sem->stats);
+	}
+	#endif
+	
+	#ifdef __DEBUG
 	printf("Semaphore lend exit, Semaphore count: %d\n", sem->count);
+	#endif
 	__enable_irq();
 	return osNoError;
 }
 
 osError_t osSemaphoreReturn(sem_t *sem) {
+	uint32_t primask = __get_PRIMASK();
 	__disable_irq();
+	#ifdef __DEBUG
 	printf("Semaphore return enter, Semaphore count: %d\n", sem->count);
-	(sem->count)++;
+	#endif
+	#ifdef __LOCK_STATS
+	if(sem->count == 0) {
+		lockStatsReleased(&sem->stats);
+	}
+	#endif
+	TRACE_EVENT(traceSemReturn, scheduler.currTCB, sem);
+	
 	if(sem->blockedList.size != 0) {
-		tcb_t *unblockedTask = tcbList_dequeue(&sem->blockedList);
-		changeState(unblockedTask, T_READY);
-		tcbList_enqueue(&scheduler.readyQueueList[unblockedTask->priority], unblockedTask);
+		// Count goes straight to the first blocked task, so a task that lends before it gets
+		// to run can not take it instead
+		tcb_t *unblockedTask = sem->blockedList.head;
+		TRACE_EVENT(traceSemLend, unblockedTask, sem);
+		
+		#ifdef __LOCK_STATS
+		lockStatsAcquired(&sem->stats, unblockedTask, true);
+		lockStatsHeld(&sem->stats);
+		#endif
+		
+		wakeBlockedTask(&sem->blockedList, unblockedTask);
 	}
+	else {
+		(sem->count)++;
+	}
+	#ifdef __DEBUG
 	printf("Semaphore return exit, Semaphore count: %d\n", sem->count);
-	__enable_irq();
+	#endif
+	__set_PRIMASK(primask);
 	return osNoError;
 }
 
+// Highest priority task blocked on the mutex, the one that waited longest among equals
+static tcb_t *mutexTopWaiter(mutex_t *mut) {
+	tcb_t *topTask = mut->blockedList.head;
+	
+	for(tcb_t *currTcb = topTask; currTcb != NULL; currTcb = currTcb->nextTcb) {
+		if(currTcb->priority > topTask->priority) {
+			topTask = currTcb;
+		}
+	}
+	return topTask;
+}
+
+// Owner runs at the higher of its own priority and that of the highest waiter. Called with
+// interrupts disabled once a waiter has left without the mutex
+static void mutexUpdateInheritance(mutex_t *mut) {
+	if(mut->inherited == false) {
+		return;
+	}
+	
+	priority_t priority = mut->originalPriority;
+	tcb_t *topWaiter = mutexTopWaiter(mut);
+	if((topWaiter != NULL) && (topWaiter->priority > priority)) {
+		priority = topWaiter->priority;
+	}
+	
+	setTaskPriority(mut->owner, priority);
+	mut->inherited = (priority != mut->originalPriority);
+}
+
 
 void osMutexInit(mutex_t *mut) {
 	mut->available = true;
 	mut->inherited = false;
 	mut->originalPriority = osPriorityNone;
 	mut->owner = NULL;
-	mut->blockedTask = NULL;
+	
+	tcbList_t blankList;
+	blankList.size = 0;
+	blankList.head = NULL;
+	blankList.tail = NULL;
+	blankList.readyBitmap = NULL;
+	blankList.readyMask = 0;
+	
+	mut->blockedList = blankList;
+	
+	#ifdef __LOCK_STATS
+	lockStatsInit(&mut->stats, osLockMutex);
+	#endif
+}
+
+void waitCancel(tcb_t *task) {
+	tcbList_remove(task->waitList, task);
+	delayList_remove(task);
+	task->waitList = NULL;
+	
+	// Owner gives back a priority it inherited from the task, so a waiter that timed out can
+	// preempt it right away
+	if(task->waitMutex != NULL) {
+		mutex_t *mut = task->waitMutex;
+		task->waitMutex = NULL;
+		mutexUpdateInheritance(mut);
+	}
 }
 
 osError_t osMutexLock(mutex_t *mut) {
+	return osMutexLockTimeout(mut, OS_WAIT_FOREVER);
+}
+
+osError_t osMutexLockTimeout(mutex_t *mut, uint32_t ticks) {
 	__disable_irq();
 	
 	// Check if mutex is already acquired
@@ -90,85 +314,156 @@ osError_t osMutexLock(mutex_t *mut) {
 			__enable_irq();
 			return osErrorInv;
 		}
-		// Place blocked task in mutex blocked task
-		mut->blockedTask = scheduler.currTCB;
-		changeState(mut->blockedTask, T_BLOCKED);
 		
-		// Dequeue the blocked task
-		tcbList_dequeue(&scheduler.readyQueueList[scheduler.currPriority]);
+		if(ticks == 0) {
+			#ifdef __LOCK_STATS
+			mut->stats.timeouts++;
+			#endif
+			__enable_irq();
+			return osErrorTimeout;
+		}
+		
+		// Idle task has to stay ready, it can only try without waiting
+		if(scheduler.currTCB == &tcb[0]) {
+			__enable_irq();
+			return osErrorPerm;
+		}
 		
-		// Check if priority inheritance is necessary
-		if(scheduler.currPriority > mut->originalPriority) {
+		// Check if priority inheritance is necessary. The owner may already run at the priority
+		// of another waiter
+		if(scheduler.currPriority > mut->owner->priority) {
 			mut->inherited = true;
-			mut->owner->priority = scheduler.currPriority;
+			#ifdef __LOCK_STATS
+			mut->stats.inheritances++;
+			#endif
 			
-			// Enqueue instance of inherited prioirty task
-			tcbList_enqueue(&scheduler.readyQueueList[mut->blockedTask->priority], mut->owner);
+			// Owner moves to the ready queue of the inherited priority
+			setTaskPriority(mut->owner, scheduler.currPriority);
 		}
+		
+		scheduler.currTCB->waitMutex = mut;
+		blockCurrentTask(&mut->blockedList, ticks);
+		
+		// Task is switched out here. osMutexUnlock hands the mutex to this task before making it
+		// ready, so only the timeout is left to check
 		__enable_irq();
-		while(runScheduler == true) {
-			printf("");
-		}
 		__disable_irq();
+		
+		osError_t result = osNoError;
+		if(scheduler.currTCB->timedOut == true) {
+			#ifdef __LOCK_STATS
+			mut->stats.timeouts++;
+			#endif
+			result = osErrorTimeout;
+		}
+		__enable_irq();
+		return result;
 	}
 	
 	// Mutex is available
 	mut->available = false;
 	mut->originalPriority = scheduler.currPriority;
-
+	
 	mut->owner = scheduler.currTCB;
+	TRACE_EVENT(traceMutexLock, scheduler.currTCB, mut);
+	
+	#ifdef __LOCK_STATS
+	lockStatsAcquired(&mut->stats, scheduler.currTCB, false);
+	lockStatsHeld(&mut->stats);
+	#endif
 	
 	__enable_irq();
 	return osNoError;
 }
 
 osError_t osMutexUnlock(mutex_t *mut) {
+	uint32_t primask = __get_PRIMASK();
 	__disable_irq();
 	
 	if(mut->available == true) {
 		printf("WARNING: available mutex cannot be unlocked\n");
-		__enable_irq();
+		__set_PRIMASK(primask);
 		return osErrorInv;
 	}
 	
 	if(scheduler.currTCB != mut->owner) {
 		printf("WARNING: mutex not owned by this task, cannot be unlocked by it\n");
-		__enable_irq();
+		__set_PRIMASK(primask);
 		return osErrorPerm;
 	}
 	
-	// Check if there is a blocked task
-	if(mut->blockedTask != NULL) {
-		// Change the state of blocked tasked from blocked to ready
-		changeState(mut->blockedTask, T_READY);
-		// Enqueue task to the scheduler
-		tcbList_enqueue(&scheduler.readyQueueList[mut->blockedTask->priority], mut->blockedTask);
-		mut->blockedTask = NULL;
-	}
+	TRACE_EVENT(traceMutexUnlock, mut->owner, mut);
+	
+	#ifdef __LOCK_STATS
+	lockStatsReleased(&mut->stats);
+	#endif
+	
 	// Check if priority was inherited
 	if(mut->inherited == true) {
-		// Remove inherited task from the inherited prioirty queue
-		tcbList_dequeue(&scheduler.readyQueueList[mut->owner->priority]);
-		
-		mut->owner->priority = mut->originalPriority;
-		mut->available = true;
+		// Owner goes back to the queue of its own priority. The task at the head of the
+		// inherited queue is not necessarily the owner
+		setTaskPriority(mut->owner, mut->originalPriority);
 		mut->inherited = false;
-		mut->owner = NULL;
-		mut->originalPriority = osPriorityNone;
+	}
+	
+	// Check if there are blocked tasks
+	if(mut->blockedList.size != 0) {
+		// Ownership passes straight to the highest priority waiter, so a task that locks the
+		// mutex before it gets to run can not take it as well
+		tcb_t *nextOwner = mutexTopWaiter(mut);
+		mut->owner = nextOwner;
+		mut->originalPriority = nextOwner->priority;
+		TRACE_EVENT(traceMutexLock, nextOwner, mut);
 		
-		changeState(scheduler.currTCB, T_READY);
-		runScheduler = true;
-		__enable_irq();
-		while(runScheduler == true) {
-			printf("");
-		}
-		__disable_irq();
+		#ifdef __LOCK_STATS
+		lockStatsAcquired(&mut->stats, nextOwner, true);
+		lockStatsHeld(&mut->stats);
+		#endif
+		
+		// Change the state of blocked tasked from blocked to ready, and enqueue it to the scheduler
+		wakeBlockedTask(&mut->blockedList, nextOwner);
+		
+		// Remaining waiters never outrank the new owner, it was the highest of them
 	}
 	else {
 		mut->available = true;
 		mut->owner = NULL;
 		mut->originalPriority = osPriorityNone;
 	}
-	__enable_irq();
+	__set_PRIMASK(primask);
 	return osNoError;
 }
+
+#ifdef __LOCK_STATS
+void osLockStatsDump(void) {
+	uint32_t cyclesPerMicro = SystemCoreClock / 1000000;
+	
+	for(osLockStats_t *lock = lockRegistry; lock != NULL; lock = lock->nextLock) {
+		// Copy the counters so the line is consistent
+		__disable_irq();
+		osLockStats_t stats = *lock;
+		__enable_irq();
+		
+		printf("LOCK %s %p acquired %d contended %d wait_us %d %d hold_us %d %d inherited %d timeouts %d\n",
+			(stats.type == osLockMutex) ? "mutex" : "semaphore", lock, stats.acquisitions, stats.contended,
+			(uint32_t)(stats.totalWait / cyclesPerMicro), stats.maxWait / cyclesPerMicro,
+			(uint32_t)(stats.totalHold / cyclesPerMicro), stats.maxHold / cyclesPerMicro, stats.inheritances, stats.timeouts);
+	}
+}
+
+void osLockStatsReset(void) {
+	__disable_irq();
+	for(osLockStats_t *lock = lockRegistry; lock != NULL; lock = lock->nextLock) {
+		// A hold in progress is still measured when it ends
+		lock->acquisitions = 0;
+		lock->contended = 0;
+		lock->totalWait = 0;
+		lock->maxWait = 0;
+		lock->totalHold = 0;
+		lock->maxHold = 0;
+		lock->inheritances = 0;
+		lock->timeouts = 0;
+	}
+	__enable_irq();
+}
+#endif
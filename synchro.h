@@ -16,14 +16,32 @@
 
 #include "scheduler.h"
 
-// Semaphore Methods
+// Semaphore Methods. osSemaphoreLendTimeout gives up with osErrorTimeout once ticks have passed
+// without a count, a timeout of 0 only takes a count that is free. osSemaphoreLend waits forever.
+// The idle task can not block, so a wait from main() that would block returns osErrorPerm
 void osSemaphoreInit(sem_t *sem, uint32_t count);
 osError_t osSemaphoreLend(sem_t *sem);
+osError_t osSemaphoreLendTimeout(sem_t *sem, uint32_t ticks);
 osError_t osSemaphoreReturn(sem_t *sem);
 
-// Mutex Methods
+// Mutex Methods. osMutexLockTimeout returns osErrorTimeout and osErrorPerm the same way, and a
+// priority the owner inherited from the task that gave up drops back
 void osMutexInit(mutex_t *mutex);
 osError_t osMutexLock(mutex_t *mutex);
+osError_t osMutexLockTimeout(mutex_t *mutex, uint32_t ticks);
 osError_t osMutexUnlock(mutex_t *mutex);
 
+// Takes a task off the semaphore or mutex it is blocked on without handing it the object, when
+// its timed wait runs out or it is deleted. Called with interrupts disabled
+void waitCancel(tcb_t *task);
+
+#ifdef __LOCK_STATS
+// Lock statistics. Initializing a semaphore or mutex clears its counters and adds it to a registry,
+// so objects must stay in place once initialized. osLockStatsDump prints one "LOCK" line for every
+// object with its acquisitions, contended acquisitions, total and maximum wait and hold times in
+// microseconds, for mutexes the priority inheritances it caused, and the timed waits that ran out
+void osLockStatsDump(void);
+void osLockStatsReset(void);
+#endif
+
 #endif //__SYNCHRO_H
@@ -13,32 +13,37 @@
 #include <stdio.h>
 
 #include "ezOS.h"
+#include "benchmark.h"
+#include "stress.h"
+#include "shell.h"
 
-// Testcase select macro
+// Testcase select macro. Builds that select one themselves, like the host port, define TESTCASE_SELECTED
+#ifndef TESTCASE_SELECTED
 #define TESTCASE1
+#endif
 
 /*
  Demonstrates that the RTOS is capable of context switching
- 
+
 	- creates three tasks of high priority 
 	- alternates between the three, demonstrating context switches
 */
 #ifdef TESTCASE1
 void testTask_1(void* arg) {
 	while(true) {
-		printf("Running Task %d\n", (uint32_t)arg);
+		printf("Running Task %d\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
 void testTask_2(void* arg) {
 	while(true) {
-		printf("Running Task %d\n", (uint32_t)arg);
+		printf("Running Task %d\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
 void testTask_3(void* arg) {
 	while(true) {
-		printf("Running Task %d\n", (uint32_t)arg);
+		printf("Running Task %d\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
@@ -49,9 +54,9 @@ int main(void) {
 	
 	__disable_irq();
 	
-	osCreateTask(testTask_1, (void*)1, osPriorityHigh);
-	osCreateTask(testTask_2, (void*)2, osPriorityHigh);
-	osCreateTask(testTask_3, (void*)3, osPriorityHigh);
+	osCreateTask(testTask_1, (void*)1, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, (void*)2, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_3, (void*)3, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
 	
 	__enable_irq();
 	
@@ -66,26 +71,26 @@ int main(void) {
 
 /*
  Demonstrates that the RTOS handles FPP scheduling
- 
+
 	- Creates three tasks, two of high priority and one of low
 	- Low priority task never runs as there are two high priority
 */
 #ifdef TESTCASE2
 void testTask_1(void* arg) {
 	while(true) {
-		printf("Running Task %d, High priority\n", (uint32_t)arg);
+		printf("Running Task %d, High priority\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
 void testTask_2(void* arg) {
 	while(true) {
-		printf("Running Task %d, High Priority\n", (uint32_t)arg);
+		printf("Running Task %d, High Priority\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
 void testTask_3(void* arg) {
 	while(true) {
-		printf("Running Task %d, Low Priority\n", (uint32_t)arg);
+		printf("Running Task %d, Low Priority\n", (uint32_t)(uintptr_t)arg);
 	}
 }
 
@@ -96,9 +101,9 @@ int main(void) {
 	
 	__disable_irq();
 	
-	osCreateTask(testTask_1, (void*)1, osPriorityHigh);
-	osCreateTask(testTask_2, (void*)2, osPriorityHigh);
-	osCreateTask(testTask_3, (void*)3, osPriorityLow);
+	osCreateTask(testTask_1, (void*)1, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, (void*)2, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_3, (void*)3, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
 	
 	__enable_irq();
 	
@@ -173,10 +178,10 @@ int main(void) {
 	
 	__disable_irq();
 	
-	osCreateTask(testTask_3, NULL, osPriorityLow);
-	osCreateTask(testTask_2, NULL, osPriorityMed);
-	osCreateTask(testTask_1, NULL, osPriorityHigh);
-
+	osCreateTask(testTask_3, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_1, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	
 	__enable_irq();
 	
 	while(true) {
@@ -246,9 +251,9 @@ int main(void) {
 	
 	__disable_irq();
 	
-	osCreateTask(testTask_1, NULL, osPriorityHigh);
-	osCreateTask(testTask_2, NULL, osPriorityHigh);
-
+	osCreateTask(testTask_1, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	
 	__enable_irq();
 	
 	while(true) {
@@ -283,7 +288,7 @@ void testTask_1(void* arg) {
 			printf("Release mutex\n");
 			osMutexUnlock(&priorityMutex);
 		}
-
+		
 		printf("Task Low is running, counter: %d\n", counter);
 	}
 }
@@ -296,7 +301,7 @@ void testTask_2(void* arg) {
 
 void testTask_3(void* arg) {
 	uint32_t counter = 0;	
-
+	
 	while(true) {
 		counter++;
 		
@@ -324,7 +329,7 @@ int main(void) {
 	
 	__disable_irq();
 	
-	osCreateTask(testTask_1, NULL, osPriorityLow);
+	osCreateTask(testTask_1, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
 	
 	tcbList_t *nextQueue = findNextTask();
 	tcb_t *lowPriorityTcb;
@@ -334,15 +339,1467 @@ int main(void) {
 	priorityMutex.owner = lowPriorityTcb;
 	priorityMutex.available = false;
 	priorityMutex.originalPriority = osPriorityLow;
+	
+	osCreateTask(testTask_2, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_3, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_4, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		printf("Running Idle Task\n");
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Compares the cycle cost of ready-queue selection against the old linear scan
+	- Uses the DWT cycle counter to time findNextTask() and a copy of the old downward scan
+	- Measures with only the idle task ready (worst case for the scan) and again with a task
+	  at each of the named priority levels
+	- The bitmap lookup should cost the same in every row, the scan grows with the distance
+	  from osPriorityMax to the highest ready level
+*/
+#ifdef TESTCASE6
+
+extern scheduler_t scheduler;
+
+// Ready queue selection as it was before the ready bitmap
+tcbList_t *linearFindNextTask(void) {
+	priority_t priorityIndex = osPriorityMax;
+	while(scheduler.partitions[0].readyQueueList[priorityIndex].head == NULL) {
+		priorityIndex--;
+	}
+	return &scheduler.partitions[0].readyQueueList[priorityIndex];
+}
+
+void testTask_1(void* arg) {
+	while(true) {
+	}
+}
+
+void measureSelection(const char *label) {
+	uint32_t start;
+	uint32_t linearCycles;
+	uint32_t bitmapCycles;
+	volatile tcbList_t *result;
+	
+	start = DWT_CYCCNT;
+	result = linearFindNextTask();
+	linearCycles = DWT_CYCCNT - start;
+	
+	start = DWT_CYCCNT;
+	result = findNextTask();
+	bitmapCycles = DWT_CYCCNT - start;
+	
+	(void)result;
+	printf("%s: linear scan %d cycles, bitmap %d cycles\n", label, linearCycles, bitmapCycles);
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	// Enable the cycle counter
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	
+	printf("%d priority levels\n", NUM_PRIORITIES);
+	measureSelection("Idle only");
+	
+	osCreateTask(testTask_1, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	measureSelection("Low ready");
+	
+	osCreateTask(testTask_1, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	measureSelection("Med ready");
+	
+	osCreateTask(testTask_1, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	measureSelection("High ready");
+	
+	osCreateTask(testTask_1, NULL, osPriorityMax, DEFAULT_STACK_SIZE, NULL);
+	measureSelection("Max ready");
+	
+	while(true) {
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Demonstrates that tasks can sleep without holding the CPU
+	- Creates two high priority periodic tasks using osDelayUntil, with periods of 500 and 1500 ticks
+	- Creates a low priority task that only runs while both high tasks sleep
+	- Periodic tasks print their release tick, which stays an exact multiple of their period
+	- Low task sleeps for 100 ticks every 1000 counts, which is when the idle task runs
+*/
+#ifdef TESTCASE7
+void testTask_1(void* arg) {
+	uint32_t period = (uint32_t)(uintptr_t)arg;
+	uint32_t lastWake = osGetTickCount();
+	
+	while(true) {
+		osDelayUntil(&lastWake, period);
+		printf("Periodic Task (%d ticks) released at tick %d\n", period, osGetTickCount());
+	}
+}
 
-	osCreateTask(testTask_2, NULL, osPriorityMed);
-	osCreateTask(testTask_3, NULL, osPriorityHigh);
-	osCreateTask(testTask_4, NULL, osPriorityHigh);
+void testTask_2(void* arg) {
+	uint32_t counter = 0;
+	
+	while(true) {
+		counter++;
+		
+		if(counter % 1000 == 0) {
+			printf("Low Task is running, counter: %d\n", counter);
+			osDelay(100);
+		}
+	}
+}
 
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(testTask_1, (void*)500, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_1, (void*)1500, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
 	__enable_irq();
 	
 	while(true) {
-		printf("Running Idle Task\n");
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Demonstrates software timers running from the timer task
+	- Creates a periodic timer every 250 ticks and a one-shot timer after 1000 ticks
+	- The one-shot timer stops the periodic one and re-arms itself for a second shot
+	- A low priority task keeps running the whole time, no polling tasks are needed
+*/
+#ifdef TESTCASE8
+
+osTimer_t periodicTimer;
+osTimer_t oneShotTimer;
+
+void periodicCallback(void* arg) {
+	printf("Periodic timer fired at tick %d\n", osGetTickCount());
+}
+
+void oneShotCallback(void* arg) {
+	static uint32_t shots = 0;
+	
+	shots++;
+	printf("One-shot timer fired at tick %d, shot %d\n", osGetTickCount(), shots);
+	
+	if(shots == 1) {
+		osTimerStop(&periodicTimer);
+		osTimerStart(&oneShotTimer, 2000);
+	}
+}
+
+void testTask_1(void* arg) {
+	uint32_t counter = 0;
+	
+	while(true) {
+		counter++;
+		
+		if(counter % 100000 == 0) {
+			printf("Low Task is running, counter: %d\n", counter);
+		}
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(testTask_1, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	osTimerCreate(&periodicTimer, periodicCallback, NULL, osTimerPeriodic);
+	osTimerCreate(&oneShotTimer, oneShotCallback, NULL, osTimerOnce);
+	osTimerStart(&periodicTimer, 250);
+	osTimerStart(&oneShotTimer, 1000);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Measures the cost of a context switch. Requires __SWITCH_BENCH in global_types.h
+	- Creates two high priority tasks that sleep for one tick at a time, so every tick
+	  switches into and out of both of them
+	- A low priority task prints the minimum, mean and maximum PendSV cost every 1000 ticks
+	  and starts a new sample window
+	- The measurement covers PendSV_Handler from its first instruction to BX LR, the 12 cycle
+	  exception entry and exit are not included
+*/
+#ifdef TESTCASE9
+#ifndef __SWITCH_BENCH
+#error "TESTCASE9 needs __SWITCH_BENCH"
+#endif
+
+void testTask_1(void* arg) {
+	while(true) {
+		osDelay(1);
+	}
+}
+
+void testTask_2(void* arg) {
+	uint32_t lastWake = osGetTickCount();
+	
+	while(true) {
+		osDelayUntil(&lastWake, 1000);
+		printSwitchStats();
+		resetSwitchStats();
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(testTask_1, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_1, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(testTask_2, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Demonstrates per-task stack sizes and bounds-checked creation
+	- Creates a small task on a static buffer and two tasks of different sizes from the pool
+	- Attempts a task larger than what is left of the pool, which fails with osErrorRes
+	- Keeps creating tasks until the TCBs run out, which also fails with osErrorRes
+	- Sizes are multiples of MIN_STACK_SIZE, so every port shows the same results
+*/
+#ifdef TESTCASE10
+
+OS_STACK_DEFINE(smallStack, 2 * MIN_STACK_SIZE);
+
+void testTask_1(void* arg) {
+	while(true) {
+		printf("Running Task %d\n", (uint32_t)(uintptr_t)arg);
+		osDelay(500);
+	}
+}
+
+int main(void) {
+	osError_t error;
+	
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	error = osCreateTaskStatic(testTask_1, (void*)1, osPriorityHigh, smallStack, sizeof(smallStack), NULL);
+	osPrintError(error);
+	
+	error = osCreateTask(testTask_1, (void*)2, osPriorityHigh, 4 * MIN_STACK_SIZE, NULL);
+	osPrintError(error);
+	
+	error = osCreateTask(testTask_1, (void*)3, osPriorityHigh, 16 * MIN_STACK_SIZE, NULL);
+	osPrintError(error);
+	
+	// Larger than the rest of the pool
+	error = osCreateTask(testTask_1, (void*)4, osPriorityHigh, STACK_POOL_SIZE, NULL);
+	osPrintError(error);
+	
+	// Runs out of TCBs
+	for(uint32_t taskCount = 4; taskCount < NUM_TCB + 1; taskCount++) {
+		error = osCreateTask(testTask_1, (void*)(uintptr_t)taskCount, osPriorityMed, MIN_STACK_SIZE, NULL);
+		osPrintError(error);
+	}
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Demonstrates task termination and TCB recycling
+	- A manager task repeatedly spawns a worker, joins it, and spawns the next one
+	- Workers return from their task function, which terminates them through osTaskExit
+	- Every worker reuses the same TCB and stack, so the loop runs forever in bounded memory.
+	  The printed task ID changes every time since the TCB reuse count is part of it
+	- A sleeping task is deleted by the manager after the first worker
+*/
+#ifdef TESTCASE11
+void workerTask(void* arg) {
+	printf("Worker %d running as task %d\n", (uint32_t)(uintptr_t)arg, osTaskSelf());
+}
+
+void sleeperTask(void* arg) {
+	while(true) {
+		osDelay(10000);
+		printf("Sleeper should have been deleted, if you see this, you messed up\n");
+	}
+}
+
+void managerTask(void* arg) {
+	tid_t sleeperTid;
+	tid_t workerTid;
+	uint32_t workerCount = 0;
+	osError_t error;
+	
+	osCreateTask(sleeperTask, NULL, osPriorityLow, MIN_STACK_SIZE, &sleeperTid);
+	
+	while(true) {
+		workerCount++;
+		error = osCreateTask(workerTask, (void*)(uintptr_t)workerCount, osPriorityLow, DEFAULT_STACK_SIZE, &workerTid);
+		if(error != osNoError) {
+			osPrintError(error);
+		}
+		osTaskJoin(workerTid);
+		
+		if(workerCount == 1) {
+			printf("Deleting sleeper task %d\n", sleeperTid);
+			osPrintError(osTaskDelete(sleeperTid));
+		}
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(managerTask, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Demonstrates time slice quanta and yielding
+	- Three spinning tasks share the low priority level, whose default quantum is set to 50 ticks
+	- The second task has its own quantum of 200 ticks and should count about 4 times as fast as the first
+	- The third task yields after every increment, so it barely counts at all
+*/
+#ifdef TESTCASE12
+volatile uint32_t spinCount[3];
+
+void spinTask(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	
+	while(true) {
+		spinCount[index]++;
+	}
+}
+
+void yieldTask(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	
+	while(true) {
+		spinCount[index]++;
+		osYield();
+	}
+}
+
+void reportTask(void* arg) {
+	while(true) {
+		osDelay(5000);
+		// Task 1 has a quantum 4 times as long as task 0, task 2 gives its slices away
+		printf("Spin counts: %d %d %d\n", spinCount[0], spinCount[1], spinCount[2]);
+	}
+}
+
+int main(void) {
+	tid_t longTid;
+	
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osSetPriorityTimeSlice(osPriorityLow, 50);
+	
+	osCreateTask(spinTask, (void*)0, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(spinTask, (void*)1, osPriorityLow, DEFAULT_STACK_SIZE, &longTid);
+	osCreateTask(yieldTask, (void*)2, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(reportTask, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	
+	osSetTimeSlice(longTid, 200);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Compares how much utilization fixed priority and EDF scheduling can handle
+	- Three periodic tasks with periods of 60, 90 and 150 ticks each take a third of the target utilization.
+	  Each job burns its execution time in a busy loop calibrated against the tick
+	- Fixed priority runs them at rate monotonic priorities, EDF runs them at one priority ordered by deadline
+	- Every utilization level runs for 5 hyperperiods under each policy and prints the jobs and deadline misses.
+	  Rate monotonic starts missing deadlines between 80% and 90%, EDF should not miss any up to 100%
+*/
+#ifdef TESTCASE13
+#define EDF_TASKS 3
+#define EDF_HYPERPERIOD 900
+#define EDF_CALIBRATE_TICKS 100
+#define EDF_BURN_CHUNK 100
+
+typedef struct {
+	uint32_t period;
+	uint32_t wcet;
+	priority_t priority;
+	uint32_t jobs;
+	uint32_t misses;
+} periodicTask_t;
+
+periodicTask_t periodicTasks[EDF_TASKS] = {
+	{60, 0, osPriorityHigh + 2, 0, 0},
+	{90, 0, osPriorityHigh + 1, 0, 0},
+	{150, 0, osPriorityHigh, 0, 0}
+};
+
+volatile uint32_t burnCounter;
+uint32_t loopsPerTick;
+uint32_t benchStart;
+volatile bool benchRunning;
+
+void burn(uint32_t loops) {
+	for(uint32_t loop = 0; loop < loops; loop++) {
+		burnCounter++;
+	}
+}
+
+void periodicTask(void* arg) {
+	periodicTask_t *task = (periodicTask_t*)arg;
+	uint32_t release = benchStart;
+	
+	osSetDeadline(osTaskSelf(), release + task->period);
+	osDelayUntil(&release, 0);
+	
+	while(benchRunning == true) {
+		burn(task->wcet * loopsPerTick);
+		
+		if((int32_t)(osGetTickCount() - (release + task->period)) > 0) {
+			task->misses++;
+		}
+		task->jobs++;
+		
+		// Deadline of the next job is set before sleeping, so it is ordered correctly when it wakes
+		osSetDeadline(osTaskSelf(), release + (2 * task->period));
+		osDelayUntil(&release, task->period);
+	}
+}
+
+void benchTask(void* arg) {
+	const uint32_t utilizations[] = {50, 60, 70, 80, 85, 90, 95, 100};
+	const osPolicy_t policies[] = {osPolicyFixed, osPolicyEDF};
+	tid_t taskIds[EDF_TASKS];
+	
+	// Count busy loop chunks over a number of ticks while nothing else runs
+	uint32_t chunks = 0;
+	uint32_t startTick = osGetTickCount();
+	while(osGetTickCount() == startTick);
+	startTick++;
+	while((osGetTickCount() - startTick) < EDF_CALIBRATE_TICKS) {
+		burn(EDF_BURN_CHUNK);
+		chunks++;
+	}
+	loopsPerTick = (chunks * EDF_BURN_CHUNK) / EDF_CALIBRATE_TICKS;
+	printf("Calibrated %d loops per tick\n", loopsPerTick);
+	
+	for(uint32_t utilIndex = 0; utilIndex < sizeof(utilizations) / sizeof(utilizations[0]); utilIndex++) {
+		for(uint32_t policyIndex = 0; policyIndex < 2; policyIndex++) {
+			uint32_t actualUtil = 0;
+			
+			osSetSchedulingPolicy(policies[policyIndex]);
+			
+			for(uint32_t taskIndex = 0; taskIndex < EDF_TASKS; taskIndex++) {
+				periodicTask_t *task = &periodicTasks[taskIndex];
+				task->wcet = (task->period * utilizations[utilIndex]) / (100 * EDF_TASKS);
+				task->jobs = 0;
+				task->misses = 0;
+				actualUtil += (task->wcet * 1000) / task->period;
+			}
+			
+			benchStart = osGetTickCount() + 1;
+			benchRunning = true;
+			
+			for(uint32_t taskIndex = 0; taskIndex < EDF_TASKS; taskIndex++) {
+				priority_t priority = periodicTasks[taskIndex].priority;
+				if(policies[policyIndex] == osPolicyEDF) {
+					priority = osPriorityHigh;
+				}
+				osCreateTask(periodicTask, &periodicTasks[taskIndex], priority, DEFAULT_STACK_SIZE, &taskIds[taskIndex]);
+			}
+			
+			osDelay(5 * EDF_HYPERPERIOD);
+			
+			// Tasks finish their current job and exit
+			benchRunning = false;
+			for(uint32_t taskIndex = 0; taskIndex < EDF_TASKS; taskIndex++) {
+				osTaskJoin(taskIds[taskIndex]);
+			}
+			
+			uint32_t jobs = 0;
+			uint32_t misses = 0;
+			for(uint32_t taskIndex = 0; taskIndex < EDF_TASKS; taskIndex++) {
+				jobs += periodicTasks[taskIndex].jobs;
+				misses += periodicTasks[taskIndex].misses;
+			}
+			
+			printf("U = %d.%d%% %s: %d jobs, %d deadline misses\n",
+						 actualUtil / 10, actualUtil % 10,
+						 (policies[policyIndex] == osPolicyEDF) ? "EDF" : "RM ",
+						 jobs, misses);
+		}
+	}
+	
+	printf("Benchmark done\n");
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(benchTask, NULL, osPriorityMax - 1, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Demonstrates periodic tasks with rate monotonic admission control
+	- Tasks are created with periods and worst case execution times, and print the tick of every job.
+	  Jobs are released at exact multiples of the period from creation
+	- The first two tasks pass the Liu-Layland bound, the third only passes response time analysis
+	- The fourth task would push utilization over 100% and is refused, the fifth fits again
+*/
+#ifdef TESTCASE14
+typedef struct {
+	uint32_t period;
+	uint32_t wcet;
+} periodicParams_t;
+
+const periodicParams_t periodicParams[] = {
+	{500, 100},
+	{1000, 300},
+	{2000, 600},
+	{4000, 1000},
+	{4000, 400}
+};
+
+void jobTask(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	uint32_t start = osGetTickCount();
+	
+	printf("Task %d job at %d\n", index, start);
+	
+	// Use up most of the execution time
+	while((osGetTickCount() - start) < (periodicParams[index].wcet / 2));
+}
+
+int main(void) {
+	osError_t error;
+	
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	for(uint32_t index = 0; index < sizeof(periodicParams) / sizeof(periodicParams[0]); index++) {
+		error = osCreatePeriodicTask(jobTask, (void*)(uintptr_t)index, periodicParams[index].period, periodicParams[index].wcet, DEFAULT_STACK_SIZE, NULL);
+		printf("Task %d, period %d, wcet %d: ", index, periodicParams[index].period, periodicParams[index].wcet);
+		osPrintError(error);
+	}
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Demonstrates execution time budgets
+	- Three tasks spin forever at high, medium and low priority, each with a budget per 1000 ticks
+	- The high task is suspended when it overruns, the medium task is demoted to background priority,
+	  and the low task calls the overrun hook
+	- A reporter prints the spin counts and overruns every second. The counts should split about
+	  300 : 200 : the rest, instead of the high task taking all of the time
+*/
+#ifdef TESTCASE15
+volatile uint32_t runawayCount[3];
+volatile uint32_t hookCount;
+
+void runawayTask(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	
+	while(true) {
+		runawayCount[index]++;
+	}
+}
+
+void overrunHook(tid_t tid) {
+	hookCount++;
+}
+
+void budgetReportTask(void* arg) {
+	while(true) {
+		osDelay(1000);
+		printf("Counts: %d %d %d, hook calls: %d\n", runawayCount[0], runawayCount[1], runawayCount[2], hookCount);
+	}
+}
+
+int main(void) {
+	tid_t taskIds[3];
+	
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osSetOverrunHook(overrunHook);
+	
+	osCreateTask(budgetReportTask, NULL, osPriorityHigh + 1, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(runawayTask, (void*)0, osPriorityHigh, DEFAULT_STACK_SIZE, &taskIds[0]);
+	osCreateTask(runawayTask, (void*)1, osPriorityMed, DEFAULT_STACK_SIZE, &taskIds[1]);
+	osCreateTask(runawayTask, (void*)2, osPriorityLow, DEFAULT_STACK_SIZE, &taskIds[2]);
+	
+	osPrintError(osSetBudget(taskIds[0], 300, 1000, osOverrunSuspend));
+	osPrintError(osSetBudget(taskIds[1], 200, 1000, osOverrunDemote));
+	osPrintError(osSetBudget(taskIds[2], 100, 1000, osOverrunHook));
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Demonstrates a time triggered schedule table
+	- Two control tasks run in fixed slots of a 100 tick major frame, at offsets 0 and 50
+	- Each one prints the tick it was dispatched on and gives up the rest of its slot.
+	  The ticks should repeat exactly every 100 ticks
+	- A background task at normal priority counts in the slack between the slots
+*/
+#ifdef TESTCASE16
+volatile uint32_t backgroundCount;
+
+void controlTask(void* arg) {
+	while(true) {
+		printf("Control %d at %d, background %d\n", (uint32_t)(uintptr_t)arg, osGetTickCount(), backgroundCount);
+		osScheduleTableWait();
+	}
+}
+
+void backgroundTask(void* arg) {
+	while(true) {
+		backgroundCount++;
+	}
+}
+
+osScheduleEntry_t scheduleTable[2];
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(controlTask, (void*)0, osPriorityMed, DEFAULT_STACK_SIZE, &scheduleTable[0].tid);
+	osCreateTask(controlTask, (void*)1, osPriorityMed, DEFAULT_STACK_SIZE, &scheduleTable[1].tid);
+	osCreateTask(backgroundTask, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	scheduleTable[0].offset = 0;
+	scheduleTable[0].length = 20;
+	scheduleTable[1].offset = 50;
+	scheduleTable[1].length = 20;
+	
+	osPrintError(osScheduleTableStart(scheduleTable, 2, 100));
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+/*
+ Demonstrates temporal partitioning
+	- Partition 1 gets 60 ticks and partition 2 gets 40 ticks of every 100 tick major frame
+	- Each partition runs a spinning task. Partition 2 also has a high priority task that loads
+	  it fully for 2 seconds out of every 5
+	- A reporter in the system partition prints the spin counts and partition statistics every second.
+	  The partition 1 count per second should not change when partition 2 gets loaded
+*/
+#ifdef TESTCASE17
+volatile uint32_t partitionCount[3];
+
+void partitionSpinTask(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	
+	while(true) {
+		partitionCount[index]++;
+	}
+}
+
+void spikeTask(void* arg) {
+	while(true) {
+		osDelay(3000);
+		
+		uint32_t start = osGetTickCount();
+		while((osGetTickCount() - start) < 2000) {
+			partitionCount[0]++;
+		}
+	}
+}
+
+void partitionReportTask(void* arg) {
+	osPartitionStats_t stats;
+	uint32_t lastCount[3] = {0, 0, 0};
+	uint32_t delta[3];
+	
+	while(true) {
+		osDelay(1000);
+		
+		// The spinners never stop counting, so the counts are compared with the last report instead of cleared
+		for(uint32_t index = 0; index < 3; index++) {
+			uint32_t count = partitionCount[index];
+			delta[index] = count - lastCount[index];
+			lastCount[index] = count;
+		}
+		printf("Counts: partition 1 %d, partition 2 %d, spike %d\n", delta[1], delta[2], delta[0]);
+		
+		for(uint8_t partition = 0; partition < 3; partition++) {
+			osPartitionGetStats(partition, &stats);
+			printf("  Partition %d: window %d, run %d, utilization %d/1000\n", partition, stats.windowTicks, stats.runTicks, stats.utilization);
+		}
+		
+		osPartitionResetStats();
+	}
+}
+
+const osPartitionWindow_t partitionWindows[] = {
+	{1, 60},
+	{2, 40}
+};
+
+int main(void) {
+	tid_t taskId;
+	
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(partitionReportTask, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	
+	osCreateTask(partitionSpinTask, (void*)1, osPriorityLow, DEFAULT_STACK_SIZE, &taskId);
+	osSetPartition(taskId, 1);
+	osCreateTask(partitionSpinTask, (void*)2, osPriorityLow, DEFAULT_STACK_SIZE, &taskId);
+	osSetPartition(taskId, 2);
+	osCreateTask(spikeTask, NULL, osPriorityMed, DEFAULT_STACK_SIZE, &taskId);
+	osSetPartition(taskId, 2);
+	
+	osPrintError(osPartitionStart(partitionWindows, 2));
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Runs the kernel benchmark suite in benchmark.c
+	- Every test runs for BENCH_INTERVAL ticks and prints its operations per second
+	- Results are printed as "BENCH <test> <value> <unit>" lines, so runs of different
+	  releases can be compared with a script
+*/
+#ifdef TESTCASE18
+void benchmarkTask(void* arg) {
+	benchmarkRun();
+	
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osCreateTask(benchmarkTask, NULL, BENCH_PRIORITY, DEFAULT_STACK_SIZE, NULL);
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Runs the randomized scheduler stress test in stress.c
+	- Workers mix semaphore lends and returns, mutex contention, yields, delays and busy loops
+	- Every tick the controller checks the ready queues, delay list and semaphore lists against
+	  the task states and changes the priority of a random worker
+	- Prints "STRESS <result> <value> <unit>" lines, the last one is pass or fail
+*/
+#ifdef TESTCASE19
+void stressTask(void* arg) {
+	stressRun(10000);
+	
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osCreateTask(stressTask, NULL, STRESS_PRIORITY, DEFAULT_STACK_SIZE, NULL);
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Demonstrates stack high-water marks and the stack overflow check
+	- Two tasks use different amounts of stack, one recursing deeper than the other
+	- The eater task recurses twice as deep every round on a stack that sits on top of a pad,
+	  so running past its stack only overwrites the pad
+	- A high priority task prints the high-water mark of each task every round
+	- Once the eater uses its whole stack, the check in PendSV calls the overflow hook and halts
+*/
+#ifdef TESTCASE20
+#define EATER_STACK_SIZE MIN_STACK_SIZE
+
+OS_STACK_DEFINE(eaterStack, 2 * EATER_STACK_SIZE);
+
+tid_t stackTids[3];
+volatile uint32_t eaterDepth = 1;
+
+uint32_t recurse(uint32_t depth) {
+	volatile uint32_t frame[8];
+	
+	frame[0] = depth;
+	if(depth == 0) {
+		// Switch out at the deepest point, where the stack check sees it
+		osDelay(1);
+		return frame[0];
+	}
+	return recurse(depth - 1) + frame[0];
+}
+
+void stackTask(void* arg) {
+	while(true) {
+		recurse((uint32_t)(uintptr_t)arg);
+		osDelay(100);
+	}
+}
+
+void eaterTask(void* arg) {
+	while(true) {
+		recurse(eaterDepth);
+		osDelay(100);
+	}
+}
+
+void overflowHook(tid_t tid) {
+	printf("Overflow hook called for task %d at depth %d\n", tid, eaterDepth);
+}
+
+void stackReportTask(void* arg) {
+	while(true) {
+		osDelay(500);
+		
+		for(uint32_t index = 0; index < 3; index++) {
+			uint32_t used;
+			uint32_t size;
+			
+			osTaskStackHighWater(stackTids[index], &used);
+			osTaskStackSize(stackTids[index], &size);
+			printf("Task %d: %d of %d bytes used\n", stackTids[index], used, size);
+		}
+		eaterDepth *= 2;
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osSetStackOverflowHook(overflowHook);
+	
+	__disable_irq();
+	
+	osCreateTask(stackReportTask, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(stackTask, (void*)2, osPriorityLow, DEFAULT_STACK_SIZE, &stackTids[0]);
+	osCreateTask(stackTask, (void*)10, osPriorityLow, DEFAULT_STACK_SIZE, &stackTids[1]);
+	
+	// Eater runs on the top half of eaterStack, the bottom half is the pad
+	osCreateTaskStatic(eaterTask, NULL, osPriorityMed, eaterStack + (EATER_STACK_SIZE / sizeof(uint32_t)), EATER_STACK_SIZE, &stackTids[2]);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Streams a scheduler trace over the UART. Build with __TRACE and decode the capture with
+ tools/trace_decode.py
+	- A producer returns a semaphore every 50 ticks and a consumer waiting on it wakes up
+	- The consumer and a low priority worker share a mutex, the worker holds it while it busy loops
+	- The trace shows the switches, blocks, unblocks and the semaphore and mutex operations
+*/
+#ifdef TESTCASE21
+#ifndef __TRACE
+#error "TESTCASE21 needs __TRACE"
+#endif
+
+sem_t traceSem;
+mutex_t traceMutex;
+
+void traceProducer(void* arg) {
+	while(true) {
+		osDelay(50);
+		osSemaphoreReturn(&traceSem);
+	}
+}
+
+void traceConsumer(void* arg) {
+	while(true) {
+		osSemaphoreLend(&traceSem);
+		osMutexLock(&traceMutex);
+		osMutexUnlock(&traceMutex);
+	}
+}
+
+void traceWorker(void* arg) {
+	while(true) {
+		osMutexLock(&traceMutex);
+		for(volatile uint32_t loop = 0; loop < 100000; loop++);
+		osMutexUnlock(&traceMutex);
+		osDelay(7);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osSemaphoreInit(&traceSem, 0);
+	osMutexInit(&traceMutex);
+	
+	__disable_irq();
+	
+	osTraceStart();
+	osCreateTask(traceConsumer, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(traceProducer, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(traceWorker, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Runs the UART shell over a mixed load. Build with __TASK_STATS, then type top into the terminal
+	- A medium priority task busy loops for 30 ticks out of every 100
+	- A waiter spends most of its time blocked on a semaphore returned every 250 ticks
+	- A low priority hog never blocks and shares its level with the shell, so idle gets no time.
+	  The level gets a short time slice so the shell still answers quickly
+	- top shows the CPU share of every task over each second, its switches and its blocked time
+*/
+#ifdef TESTCASE22
+#ifndef __TASK_STATS
+#error "TESTCASE22 needs __TASK_STATS"
+#endif
+
+sem_t statsSem;
+
+void statsBurner(void* arg) {
+	uint32_t wakeTime = osGetTickCount();
+	
+	while(true) {
+		uint32_t start = osGetTickCount();
+		while((osGetTickCount() - start) < 30);
+		osDelayUntil(&wakeTime, 100);
+	}
+}
+
+void statsWaiter(void* arg) {
+	while(true) {
+		osSemaphoreLend(&statsSem);
+	}
+}
+
+void statsProducer(void* arg) {
+	while(true) {
+		osDelay(250);
+		osSemaphoreReturn(&statsSem);
+	}
+}
+
+void statsHog(void* arg) {
+	while(true);
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osSemaphoreInit(&statsSem, 0);
+	
+	// Short slices at the hog's level, so the shell answers quickly
+	osSetPriorityTimeSlice(osPriorityLow, 10);
+	
+	__disable_irq();
+	
+	osShellStart();
+	osCreateTask(statsBurner, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(statsWaiter, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(statsProducer, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(statsHog, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Profiles tasks with the PC sampling profiler. Build with __PROFILE and run the output through
+ tools/profile_symbolize.py with the image
+	- One task spends three quarters of its time in profileHot and the rest in profileWarm
+	- Another task spins in profileCold for 2 ticks out of every 10 and sleeps the rest
+	- After 2000 ticks, a high priority task stops the profiler and prints the histograms
+*/
+#ifdef TESTCASE23
+#ifndef __PROFILE
+#error "TESTCASE23 needs __PROFILE"
+#endif
+
+volatile uint32_t profileSink;
+
+__attribute__((noinline)) void profileHot(void) {
+	for(uint32_t loop = 0; loop < 30000; loop++) {
+		profileSink ^= loop;
+	}
+}
+
+__attribute__((noinline)) void profileWarm(void) {
+	for(uint32_t loop = 0; loop < 10000; loop++) {
+		profileSink ^= loop;
+	}
+}
+
+__attribute__((noinline)) void profileCold(void) {
+	uint32_t start = osGetTickCount();
+	while((osGetTickCount() - start) < 2) {
+		profileSink++;
+	}
+}
+
+void profileBusyTask(void* arg) {
+	while(true) {
+		profileHot();
+		profileWarm();
+	}
+}
+
+void profileSleepyTask(void* arg) {
+	while(true) {
+		profileCold();
+		osDelay(8);
+	}
+}
+
+void profileReportTask(void* arg) {
+	osDelay(2000);
+	osProfileStop();
+	osProfileDump();
+	
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	__disable_irq();
+	
+	osCreateTask(profileReportTask, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(profileSleepyTask, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(profileBusyTask, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	osProfileStart();
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Shows the lock statistics. Build with __LOCK_STATS
+	- A low priority task holds a mutex for 5 ticks at a time, a high priority task locks the
+	  same mutex every 20 ticks, so it waits and lends its priority to the holder
+	- Two medium priority tasks share a binary semaphore, each holding it across a one tick sleep
+	- After 2000 ticks the statistics of both objects are printed
+*/
+#ifdef TESTCASE24
+#ifndef __LOCK_STATS
+#error "TESTCASE24 needs __LOCK_STATS"
+#endif
+
+mutex_t statsMutex;
+sem_t statsBinary;
+
+void lockHolder(void* arg) {
+	while(true) {
+		osMutexLock(&statsMutex);
+		uint32_t start = osGetTickCount();
+		while((osGetTickCount() - start) < 5);
+		osMutexUnlock(&statsMutex);
+		osDelay(3);
+	}
+}
+
+void lockWaiter(void* arg) {
+	while(true) {
+		osDelay(20);
+		osMutexLock(&statsMutex);
+		osMutexUnlock(&statsMutex);
+	}
+}
+
+void semaphoreUser(void* arg) {
+	while(true) {
+		osSemaphoreLend(&statsBinary);
+		osDelay(1);
+		osSemaphoreReturn(&statsBinary);
+		osDelay(1 + (uint32_t)(uintptr_t)arg);
+	}
+}
+
+void lockReportTask(void* arg) {
+	osDelay(2000);
+	osLockStatsDump();
+	
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osMutexInit(&statsMutex);
+	osSemaphoreInit(&statsBinary, 1);
+	
+	__disable_irq();
+	
+	osCreateTask(lockReportTask, NULL, osPriorityMax, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(lockWaiter, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(semaphoreUser, (void*)0, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(semaphoreUser, (void*)1, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(lockHolder, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Shows timed semaphore and mutex waits
+	- A low priority task locks a mutex and holds it for 300 ticks
+	- A high priority task tries to lock it with a 50 tick timeout. The holder inherits its
+	  priority while it waits and drops back to low once the wait runs out with osErrorTimeout
+	- The high priority task then waits up to 1000 ticks and gets the mutex when it is unlocked
+	- A medium priority task returns a semaphore every 250 ticks. The high priority task waits
+	  for it with a 100 tick timeout, so two waits run out for every one that gets the count
+*/
+#ifdef TESTCASE25
+
+mutex_t timeoutMutex;
+sem_t timeoutSignal;
+
+void timeoutHolder(void* arg) {
+	osMutexLock(&timeoutMutex);
+	
+	uint32_t start = osGetTickCount();
+	while((osGetTickCount() - start) < 300);
+	
+	osMutexUnlock(&timeoutMutex);
+	
+	while(true) {
+		osDelay(10000);
+	}
+}
+
+void timeoutSignaller(void* arg) {
+	while(true) {
+		osDelay(250);
+		osSemaphoreReturn(&timeoutSignal);
+	}
+}
+
+void timeoutService(void* arg) {
+	osError_t error;
+	
+	// Let the holder lock the mutex first
+	osDelay(10);
+	
+	error = osMutexLockTimeout(&timeoutMutex, 50);
+	printf("Tick %d, mutex lock with a 50 tick timeout: ", osGetTickCount());
+	osPrintError(error);
+	printf("Holder priority after the timeout: %d\n", timeoutMutex.owner->priority);
+	
+	error = osMutexLockTimeout(&timeoutMutex, 1000);
+	printf("Tick %d, mutex lock with a 1000 tick timeout: ", osGetTickCount());
+	osPrintError(error);
+	osMutexUnlock(&timeoutMutex);
+	
+	while(true) {
+		error = osSemaphoreLendTimeout(&timeoutSignal, 100);
+		printf("Tick %d, semaphore lend with a 100 tick timeout: ", osGetTickCount());
+		osPrintError(error);
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	osMutexInit(&timeoutMutex);
+	osSemaphoreInit(&timeoutSignal, 0);
+	
+	__disable_irq();
+	
+	osCreateTask(timeoutService, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(timeoutSignaller, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(timeoutHolder, NULL, osPriorityLow, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
+	}
+	return 0;
+}
+#endif
+
+
+
+/*
+ Checks that tickless idle keeps time. Build with __TICKLESS, on the target only
+	- Timer 0 counts at the tick rate and keeps counting while the core sleeps, as a reference clock.
+	  Its match interrupt every 37 ticks wakes the core in the middle of suppressed ticks
+	- A task sleeps for 7, 100 and 1234 ticks in turn. Each sleep must take that many ticks, or one
+	  more if a tick passes before it blocks
+	- A periodic task wakes every 500 ticks with osDelayUntil. It must wake on the exact tick, and
+	  osGetTickCount() must stay within a tick of timer 0
+	- Lines that break these rules end in WRONG
+*/
+#ifdef TESTCASE26
+#ifndef __TICKLESS
+#error "TESTCASE26 needs __TICKLESS"
+#endif
+
+const uint32_t sleepLengths[] = {7, 100, 1234};
+
+volatile uint32_t earlyWakes;
+uint32_t referenceStart;
+uint32_t tickStart;
+
+void TIMER0_IRQHandler(void) {
+	// Clear the match 0 interrupt and move the match on, the counter keeps running
+	LPC_TIM0->IR = 1;
+	LPC_TIM0->MR0 += 37;
+	earlyWakes++;
+}
+
+void sleepCheckTask(void* arg) {
+	uint32_t index = 0;
+	
+	while(true) {
+		uint32_t ticks = sleepLengths[index];
+		uint32_t start = osGetTickCount();
+		
+		osDelay(ticks);
+		
+		uint32_t slept = osGetTickCount() - start;
+		printf("Slept %d ticks for osDelay(%d)%s\n", slept, ticks, ((slept < ticks) || (slept > (ticks + 1))) ? ", WRONG" : "");
+		
+		index = (index + 1) % (sizeof(sleepLengths) / sizeof(sleepLengths[0]));
+	}
+}
+
+void driftCheckTask(void* arg) {
+	uint32_t wakeTime = osGetTickCount();
+	
+	while(true) {
+		osDelayUntil(&wakeTime, 500);
+		
+		// A tick may pass between the two reads, so they can be one apart
+		uint32_t now = osGetTickCount();
+		int32_t drift = (int32_t)((now - tickStart) - (LPC_TIM0->TC - referenceStart));
+		bool wrong = (now != wakeTime) || (drift < -1) || (drift > 1);
+		printf("Woke at %d for %d, %d ticks from timer 0, %d early wakes%s\n", now, wakeTime, drift, earlyWakes, wrong ? ", WRONG" : "");
+	}
+}
+
+int main(void) {
+	printf("Program Start\n\n");
+	
+	osInitialize();
+	
+	// Timer 0 on the core clock, prescaled to count ticks, interrupting on match 0
+	LPC_SC->PCONP |= 1 << 1;
+	LPC_SC->PCLKSEL0 = (LPC_SC->PCLKSEL0 & ~(3u << 2)) | (1u << 2);
+	LPC_TIM0->TCR = 2;
+	LPC_TIM0->PR = (SystemCoreClock / TICK_RATE_HZ) - 1;
+	LPC_TIM0->MR0 = 37;
+	LPC_TIM0->MCR = 1;
+	NVIC_EnableIRQ(TIMER0_IRQn);
+	
+	__disable_irq();
+	
+	LPC_TIM0->TCR = 1;
+	referenceStart = LPC_TIM0->TC;
+	tickStart = osGetTickCount();
+	
+	osCreateTask(driftCheckTask, NULL, osPriorityHigh, DEFAULT_STACK_SIZE, NULL);
+	osCreateTask(sleepCheckTask, NULL, osPriorityMed, DEFAULT_STACK_SIZE, NULL);
+	
+	__enable_irq();
+	
+	while(true) {
+		osIdle();
 	}
 	return 0;
 }
@@ -0,0 +1,311 @@
+/*
+
+	Source file for software timer methods
+	
+	Author: Boris Kim
+
+*/
+
+#include "timer.h"
+#include "ezOS.h"
+
+/**********************************************GLOBAL VARIABLES********************************************/
+// Global scheduler
+extern scheduler_t scheduler;
+extern uint32_t msTicks;
+
+// Timing wheel. The extra list after the last level holds timers that have expired and
+// are waiting for their callback to run
+static osTimer_t *timerWheel[TIMER_WHEEL_LEVELS + 1][TIMER_WHEEL_SLOTS];
+static uint32_t wheelBitmap[TIMER_WHEEL_LEVELS];
+static const uint8_t EXPIRED_LEVEL = TIMER_WHEEL_LEVELS;
+
+// Next tick the wheel has to process
+static uint32_t wheelTime;
+
+// Timer task, and whether it is blocked waiting for SysTick
+static tcb_t *timerTcb = NULL;
+static bool timerTaskCreated = false;
+static bool timerTaskWaiting = false;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+static void timerList_insert(osTimer_t *timer, uint8_t level, uint8_t slot) {
+	osTimer_t **head = &timerWheel[level][slot];
+	
+	timer->level = level;
+	timer->slot = slot;
+	timer->prevTimer = NULL;
+	timer->nextTimer = *head;
+	
+	if(*head != NULL) {
+		(*head)->prevTimer = timer;
+	}
+	*head = timer;
+	
+	if(level != EXPIRED_LEVEL) {
+		wheelBitmap[level] |= 1u << slot;
+	}
+}
+
+static void timerList_remove(osTimer_t *timer) {
+	osTimer_t **head = &timerWheel[timer->level][timer->slot];
+	osTimer_t *prevTimer = timer->prevTimer;
+	osTimer_t *nextTimer = timer->nextTimer;
+	
+	if(prevTimer == NULL) {
+		*head = nextTimer;
+	}
+	else {
+		prevTimer->nextTimer = nextTimer;
+	}
+	
+	if(nextTimer != NULL) {
+		nextTimer->prevTimer = prevTimer;
+	}
+	
+	timer->nextTimer = NULL;
+	timer->prevTimer = NULL;
+	
+	if((*head == NULL) && (timer->level != EXPIRED_LEVEL)) {
+		wheelBitmap[timer->level] &= ~(1u << timer->slot);
+	}
+}
+
+// Places a timer in the wheel relative to wheelTime. Called with interrupts disabled
+static void wheelInsert(osTimer_t *timer) {
+	uint32_t delta = timer->expiry - wheelTime;
+	uint32_t expiry = timer->expiry;
+	uint8_t level = 0;
+	
+	// Beyond the range of the wheel, park it in the furthest slot. It is cascaded and
+	// placed again once the wheel gets there
+	const uint32_t WHEEL_RANGE = 1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+	if(delta >= WHEEL_RANGE) {
+		delta = WHEEL_RANGE - 1;
+		expiry = wheelTime + delta;
+	}
+	
+	// Find the first level whose slots cover the remaining time
+	while(delta >= (1u << (TIMER_WHEEL_BITS * (level + 1)))) {
+		level++;
+	}
+	
+	uint8_t slot = (expiry >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+	timerList_insert(timer, level, slot);
+}
+
+// Checks if the timer task has to run on a tick: a timer expires, or a slot has to be cascaded
+static bool wheelNeedsTick(uint32_t tick) {
+	for(uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint8_t slot = (tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+		
+		if((wheelBitmap[level] & (1u << slot)) != 0) {
+			return true;
+		}
+		
+		// Higher levels only cascade when every level below wraps on this tick
+		if(slot != 0) {
+			return false;
+		}
+	}
+	return false;
+}
+
+// Processes one tick of the wheel: cascades higher levels down and moves expired timers
+// to the expired list. Called with interrupts disabled
+static void wheelProcessTick(void) {
+	uint32_t tick = wheelTime;
+	
+	// Cascade from the lowest level that wraps, so timers land in their final slot
+	for(uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		if(((tick >> (TIMER_WHEEL_BITS * (level - 1))) & TIMER_WHEEL_MASK) != 0) {
+			break;
+		}
+		
+		uint8_t slot = (tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+		while(timerWheel[level][slot] != NULL) {
+			osTimer_t *timer = timerWheel[level][slot];
+			timerList_remove(timer);
+			wheelInsert(timer);
+		}
+	}
+	
+	uint8_t slot = tick & TIMER_WHEEL_MASK;
+	while(timerWheel[0][slot] != NULL) {
+		osTimer_t *timer = timerWheel[0][slot];
+		timerList_remove(timer);
+		
+		// Parked timers that reached the end of the wheel still have time left
+		if(timer->expiry != tick) {
+			wheelInsert(timer);
+		}
+		else {
+			timerList_insert(timer, EXPIRED_LEVEL, 0);
+		}
+	}
+	
+	wheelTime++;
+}
+
+static void timerTask(void *argument) {
+	__disable_irq();
+	timerTcb = scheduler.currTCB;
+	
+	while(true) {
+		// Catch up with every tick since the task last ran
+		while((int32_t)(msTicks - wheelTime) >= 0) {
+			wheelProcessTick();
+			
+			// Run callbacks with interrupts enabled. The list is re-read every time
+			// since a callback may stop another expired timer
+			while(timerWheel[EXPIRED_LEVEL][0] != NULL) {
+				osTimer_t *timer = timerWheel[EXPIRED_LEVEL][0];
+				timerList_remove(timer);
+				timer->active = false;
+				
+				// Reload from the previous expiry so periodic timers do not drift
+				if(timer->type == osTimerPeriodic) {
+					timer->expiry += timer->period;
+					timer->active = true;
+					wheelInsert(timer);
+				}
+				
+				osTimerFunc_t callback = timer->callback;
+				void *callbackArgument = timer->argument;
+				
+				__enable_irq();
+				callback(callbackArgument);
+				__disable_irq();
+			}
+		}
+		
+		// Nothing left to do. Block until SysTick finds a tick with work on it
+		timerTaskWaiting = true;
+		changeState(timerTcb, T_BLOCKED);
+		tcbList_remove(readyQueue(timerTcb), timerTcb);
+		triggerScheduler();
+		
+		__enable_irq();
+		__disable_irq();
+	}
+}
+
+void timerTick(void) {
+	if(timerTaskWaiting == false) {
+		return;
+	}
+	
+	if(wheelNeedsTick(msTicks) == true) {
+		timerTaskWaiting = false;
+		changeState(timerTcb, T_READY);
+		tcbList_enqueue(readyQueue(timerTcb), timerTcb);
+	}
+	else {
+		// Nothing due on this tick, advance the wheel without waking the task
+		wheelTime = msTicks + 1;
+	}
+}
+
+#ifdef __TICKLESS
+uint32_t timerNextEvent(uint32_t maxTicks) {
+	// Timer task is running or was never created
+	if(timerTaskWaiting == false) {
+		return maxTicks;
+	}
+	
+	for(uint32_t ticks = 1; ticks < maxTicks; ticks++) {
+		if(wheelNeedsTick(msTicks + ticks) == true) {
+			return ticks;
+		}
+	}
+	return maxTicks;
+}
+
+void timerSkipTicks(uint32_t ticks) {
+	// Ticks skipped by tickless idle never have timer work on them
+	if(timerTaskWaiting == true) {
+		wheelTime += ticks;
+	}
+}
+#endif
+
+osError_t osTimerCreate(osTimer_t *timer, osTimerFunc_t callback, void *argument, osTimerType_t type) {
+	if((timer == NULL) || (callback == NULL)) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	timer->nextTimer = NULL;
+	timer->prevTimer = NULL;
+	timer->callback = callback;
+	timer->argument = argument;
+	timer->type = type;
+	timer->period = 0;
+	timer->expiry = 0;
+	timer->active = false;
+	
+	// Timer task is only created once the first timer exists
+	if(timerTaskCreated == false) {
+		wheelTime = msTicks + 1;
+		
+		osError_t error = osCreateTask(timerTask, NULL, TIMER_PRIORITY, TIMER_STACK_SIZE, NULL);
+		if(error != osNoError) {
+			__set_PRIMASK(primask);
+			return error;
+		}
+		timerTaskCreated = true;
+	}
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+osError_t osTimerStart(osTimer_t *timer, uint32_t ticks) {
+	if(ticks == 0) {
+		return osErrorInv;
+	}
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	// Restart an active timer from now
+	if(timer->active == true) {
+		timerList_remove(timer);
+	}
+	
+	timer->period = ticks;
+	timer->expiry = msTicks + ticks;
+	timer->active = true;
+	wheelInsert(timer);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+void timerCancel(osTimer_t *timer) {
+	if(timer->active == true) {
+		timerList_remove(timer);
+		timer->active = false;
+	}
+}
+
+osError_t osTimerStop(osTimer_t *timer) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if(timer->active == false) {
+		__set_PRIMASK(primask);
+		return osErrorInv;
+	}
+	
+	timerCancel(timer);
+	
+	__set_PRIMASK(primask);
+	return osNoError;
+}
+
+bool osTimerIsActive(osTimer_t *timer) {
+	return timer->active;
+}
@@ -0,0 +1,52 @@
+/*
+
+	Header file for software timer methods
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __TIMER_H
+#define __TIMER_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// Timer callbacks run from this task, created on the first osTimerCreate
+#define TIMER_PRIORITY osPriorityMax
+#ifndef TIMER_STACK_SIZE
+#define TIMER_STACK_SIZE DEFAULT_STACK_SIZE
+#endif
+
+// Hierarchical timing wheel. Each level has 32 slots, one bit each in the level's bitmap.
+// Level n slots are 32^n ticks wide, so four levels cover 2^20 ticks before a timer is
+// parked in the last level and cascaded again
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 5
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// Timer Methods. osTimerCreate takes a timer that is not initialised yet, so it can not tell whether
+// the timer is running. A running timer must be stopped with osTimerStop before it is created again
+osError_t osTimerCreate(osTimer_t *timer, osTimerFunc_t callback, void *argument, osTimerType_t type);
+osError_t osTimerStart(osTimer_t *timer, uint32_t ticks);
+osError_t osTimerStop(osTimer_t *timer);
+bool osTimerIsActive(osTimer_t *timer);
+
+// Stops a timer if it is active. Called with interrupts disabled
+void timerCancel(osTimer_t *timer);
+
+// Tick hook, called from SysTick_Handler. Wakes the timer task only on ticks with work to do
+void timerTick(void);
+
+#ifdef __TICKLESS
+// Ticks until the next tick the timer task has work on
+uint32_t timerNextEvent(uint32_t maxTicks);
+void timerSkipTicks(uint32_t ticks);
+#endif
+
+#endif //__TIMER_H
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+	Symbolizer for the PC sampling profiler of profile.c. Reads the "PROFILE" lines printed by
+	osProfileDump from a UART capture, looks every PC up in the symbol table of the image and
+	prints the hottest functions of every task
+
+		python3 tools/profile_symbolize.py ezOS.axf capture.txt
+		python3 tools/profile_symbolize.py --nm nm host/ezos capture.txt
+
+	Author: Boris Kim
+"""
+
+import argparse
+import bisect
+import re
+import subprocess
+import sys
+
+PROFILE_LINE = re.compile(r"PROFILE (\d+) ([0-9a-fA-F]{8}|dropped) (\d+)")
+
+# Symbol types of code in nm output
+CODE_TYPES = "TtWw"
+
+
+def readSymbols(nm, image):
+	"""Returns the sorted start addresses of the functions in the image and their names"""
+	output = subprocess.run([nm, "--defined-only", "-n", image], check=True, capture_output=True, text=True).stdout
+
+	starts = []
+	names = []
+	for line in output.splitlines():
+		fields = line.split()
+		if (len(fields) != 3) or (fields[1] not in CODE_TYPES):
+			continue
+
+		# Thumb functions have bit 0 of their address set
+		address = int(fields[0], 16) & ~1
+		if starts and (starts[-1] == address):
+			continue
+		starts.append(address)
+		names.append(fields[2])
+	return starts, names
+
+
+def symbolize(starts, names, pc):
+	index = bisect.bisect_right(starts, pc) - 1
+	if index < 0:
+		return "?"
+	return names[index]
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Symbolize an ezOS PC sampling profile")
+	parser.add_argument("image", help="ELF image the profile was taken on")
+	parser.add_argument("capture", nargs="?", help="UART capture, stdin when left out")
+	parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm of the image's toolchain")
+	parser.add_argument("--top", type=int, default=10, help="functions listed for every task")
+	arguments = parser.parse_args()
+
+	if arguments.capture is None:
+		lines = sys.stdin.read().splitlines()
+	else:
+		with open(arguments.capture, errors="replace") as capture:
+			lines = capture.read().splitlines()
+
+	starts, names = readSymbols(arguments.nm, arguments.image)
+
+	# Samples of every task by function, and the ones that could not be placed
+	functions = {}
+	dropped = {}
+	for line in lines:
+		match = PROFILE_LINE.search(line)
+		if match is None:
+			continue
+
+		tid = int(match.group(1))
+		count = int(match.group(3))
+		functions.setdefault(tid, {})
+
+		if match.group(2) == "dropped":
+			dropped[tid] = dropped.get(tid, 0) + count
+			continue
+
+		name = symbolize(starts, names, int(match.group(2), 16))
+		functions[tid][name] = functions[tid].get(name, 0) + count
+
+	for tid in sorted(functions):
+		samples = sum(functions[tid].values()) + dropped.get(tid, 0)
+		print("task %d: %d samples, %d dropped" % (tid, samples, dropped.get(tid, 0)))
+
+		ranked = sorted(functions[tid].items(), key=lambda item: item[1], reverse=True)
+		for name, count in ranked[:arguments.top]:
+			print("  %6.1f%% %8d  %s" % (100.0 * count / samples, count, name))
+
+
+if __name__ == "__main__":
+	main()
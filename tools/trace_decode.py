@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+	Decoder for the binary scheduler trace of trace.c. Reads the UART capture, which may hold
+	printf text between the frames, and prints a timeline and the time every task ran
+
+		python3 tools/trace_decode.py capture.bin
+		./host/ezos | python3 tools/trace_decode.py
+
+	Author: Boris Kim
+"""
+
+import argparse
+import sys
+
+TRACE_SYNC = 0xA5
+TRACE_FRAME_SIZE = 10
+NO_TASK = 0xFF
+SYSTICK_EXCEPTION = 15
+
+# Clock assumed until the traceStart frame gives the real one
+DEFAULT_MHZ = 100
+
+EVENTS = {
+	0: "start",
+	1: "lost",
+	2: "switch_in",
+	3: "switch_out",
+	4: "block",
+	5: "unblock",
+	6: "sem_lend",
+	7: "sem_return",
+	8: "mutex_lock",
+	9: "mutex_unlock",
+	10: "isr_enter",
+	11: "isr_exit",
+}
+
+STATES = {0: "inactive", 1: "ready", 2: "running", 3: "blocked"}
+
+TRACE_START = 0
+TRACE_LOST = 1
+TRACE_SWITCH_IN = 2
+TRACE_SWITCH_OUT = 3
+TRACE_BLOCK = 4
+TRACE_UNBLOCK = 5
+TRACE_ISR_ENTER = 10
+TRACE_ISR_EXIT = 11
+
+
+def frames(data):
+	"""Yields (event, task, data, cycles) for every frame with a valid checksum. A sync byte
+	that does not start a valid frame is skipped, which resynchronises after printf text or a
+	frame cut in half by it"""
+	index = 0
+	while True:
+		index = data.find(bytes([TRACE_SYNC]), index)
+		if (index < 0) or (index + TRACE_FRAME_SIZE > len(data)):
+			return
+
+		body = data[index + 1:index + TRACE_FRAME_SIZE - 1]
+		checksum = 0
+		for byte in body:
+			checksum ^= byte
+
+		if (checksum != data[index + TRACE_FRAME_SIZE - 1]) or (body[0] not in EVENTS):
+			index += 1
+			continue
+
+		yield (body[0], body[1], body[2] | (body[3] << 8), int.from_bytes(body[4:8], "little"))
+		index += TRACE_FRAME_SIZE
+
+
+def taskName(task):
+	if task == NO_TASK:
+		return "-"
+	if task == 0:
+		return "idle"
+	return "task%d" % task
+
+
+def detail(event, data):
+	if event == TRACE_START:
+		return "%d MHz" % data
+	if event == TRACE_LOST:
+		return "%d events dropped" % data
+	if event == TRACE_SWITCH_IN:
+		return "priority %d" % data
+	if event in (TRACE_SWITCH_OUT, TRACE_UNBLOCK):
+		return STATES.get(data, str(data))
+	if event in (TRACE_ISR_ENTER, TRACE_ISR_EXIT):
+		return "SysTick" if data == SYSTICK_EXCEPTION else "exception %d" % data
+	if event == TRACE_BLOCK:
+		return ""
+	return "object 0x%04x" % data
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Decode an ezOS scheduler trace")
+	parser.add_argument("capture", nargs="?", help="UART capture, stdin when left out")
+	parser.add_argument("--summary", action="store_true", help="only print the run time of every task")
+	arguments = parser.parse_args()
+
+	if arguments.capture is None:
+		data = sys.stdin.buffer.read()
+	else:
+		with open(arguments.capture, "rb") as capture:
+			data = capture.read()
+
+	mhz = DEFAULT_MHZ
+	base = None
+	previous = 0
+	wraps = 0
+
+	running = None
+	runStart = 0
+	runTime = {}
+	switches = {}
+	count = 0
+
+	for event, task, value, cycles in frames(data):
+		# DWT_CYCCNT wraps every 2^32 cycles, about 43 s at 100 MHz. Frames come in order, so a
+		# smaller count means it wrapped
+		if (base is not None) and (cycles < previous):
+			wraps += 1
+		previous = cycles
+		cycles += wraps << 32
+
+		if event == TRACE_START:
+			mhz = value if value != 0 else DEFAULT_MHZ
+			base = cycles
+		elif base is None:
+			base = cycles
+
+		time = (cycles - base) / mhz
+		count += 1
+
+		if event == TRACE_SWITCH_IN:
+			if running is not None:
+				runTime[running] = runTime.get(running, 0) + (time - runStart)
+			running = task
+			runStart = time
+			switches[task] = switches.get(task, 0) + 1
+
+		if not arguments.summary:
+			print("%12.1f us  %-6s %-13s %s" % (time, taskName(task), EVENTS[event], detail(event, value)))
+
+	if running is not None:
+		runTime[running] = runTime.get(running, 0) + (time - runStart)
+
+	total = sum(runTime.values())
+	print("\n%d events" % count)
+	print("%-6s %14s %7s %9s" % ("task", "run time us", "share", "switches"))
+	for task in sorted(runTime):
+		share = (100.0 * runTime[task] / total) if total > 0 else 0.0
+		print("%-6s %14.1f %6.1f%% %9d" % (taskName(task), runTime[task], share, switches.get(task, 0)))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,128 @@
+/*
+
+	Source file for the binary scheduler trace. Kernel events are written into a RAM ring buffer
+	with a DWT_CYCCNT timestamp, and a low priority task sends them over the UART in frames that
+	tools/trace_decode.py turns back into a timeline
+	
+	Author: Boris Kim
+
+*/
+
+#include "trace.h"
+#include "ezOS.h"
+
+#ifdef __TRACE
+
+/**********************************************GLOBAL VARIABLES********************************************/
+extern tcb_t tcb[NUM_TCB];
+
+// Ring buffer. traceHead is only written by traceRecord, traceTail only by the drain task
+static traceEvent_t traceBuffer[TRACE_BUFFER_EVENTS];
+static volatile uint32_t traceHead;
+static volatile uint32_t traceTail;
+
+// Events dropped since the drain task last reported it
+static volatile uint32_t traceDropped;
+
+// Drain task, its own events are not recorded
+static tcb_t *traceTask = NULL;
+
+static const uint32_t TRACE_MASK = TRACE_BUFFER_EVENTS - 1;
+static const uint8_t TRACE_NO_TASK = 0xFF;
+/**********************************************GLOBAL VARIABLES********************************************/
+
+void traceRecord(traceEventType_t event, tcb_t *task, uint32_t data) {
+	if((task == traceTask) && (task != NULL)) {
+		return;
+	}
+	
+	// May be called inside a critical section, so the interrupt state is restored afterwards
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if((traceHead - traceTail) < TRACE_BUFFER_EVENTS) {
+		traceEvent_t *entry = &traceBuffer[traceHead & TRACE_MASK];
+		
+		entry->cycles = DWT_CYCCNT;
+		entry->event = event;
+		entry->task = (task != NULL) ? (uint8_t)(task - tcb) : TRACE_NO_TASK;
+		entry->data = (uint16_t)data;
+		traceHead++;
+	}
+	else {
+		traceDropped++;
+	}
+	
+	__set_PRIMASK(primask);
+}
+
+static void traceSend(uint8_t event, uint8_t task, uint16_t data, uint32_t cycles) {
+	uint8_t frame[TRACE_FRAME_SIZE];
+	uint8_t checksum = 0;
+	
+	frame[0] = TRACE_SYNC;
+	frame[1] = event;
+	frame[2] = task;
+	frame[3] = data & 0xFF;
+	frame[4] = data >> 8;
+	frame[5] = cycles & 0xFF;
+	frame[6] = (cycles >> 8) & 0xFF;
+	frame[7] = (cycles >> 16) & 0xFF;
+	frame[8] = cycles >> 24;
+	
+	for(uint32_t index = 1; index < (TRACE_FRAME_SIZE - 1); index++) {
+		checksum ^= frame[index];
+	}
+	frame[TRACE_FRAME_SIZE - 1] = checksum;
+	
+	for(uint32_t index = 0; index < TRACE_FRAME_SIZE; index++) {
+		UARTSendChar(TRACE_UART_PORT, frame[index]);
+	}
+}
+
+static void traceDrainTask(void *argument) {
+	while(true) {
+		while(traceTail != traceHead) {
+			traceEvent_t event = traceBuffer[traceTail & TRACE_MASK];
+			traceTail++;
+			
+			traceSend(event.event, event.task, event.data, event.cycles);
+		}
+		
+		// Report drops once there is room again, so the decoder knows the timeline has a gap
+		if(traceDropped != 0) {
+			__disable_irq();
+			uint32_t dropped = traceDropped;
+			traceDropped = 0;
+			__enable_irq();
+			
+			traceSend(traceLost, TRACE_NO_TASK, (dropped > 0xFFFF) ? 0xFFFF : dropped, DWT_CYCCNT);
+		}
+		
+		osDelay(TRACE_DRAIN_PERIOD);
+	}
+}
+
+osError_t osTraceStart(void) {
+	if(traceTask != NULL) {
+		return osErrorInv;
+	}
+	
+	// Timestamps come from the cycle counter
+	CoreDebug->DEMCR |= DEMCR_TRCENA;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+	
+	UARTInit(TRACE_UART_PORT, TRACE_BAUD_RATE);
+	
+	// First event in the buffer, it gives the decoder the clock and the start of the timeline
+	traceRecord(traceStart, NULL, SystemCoreClock / 1000000);
+	
+	tid_t drainTid;
+	osError_t error = osCreateTask(traceDrainTask, NULL, TRACE_DRAIN_PRIORITY, TRACE_DRAIN_STACK_SIZE, &drainTid);
+	if(error == osNoError) {
+		traceTask = &tcb[drainTid & TID_INDEX_MASK];
+	}
+	return error;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+
+	Header file for the binary scheduler trace
+	
+	Author: Boris Kim
+
+*/
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <LPC17xx.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "global_types.h"
+
+// Events held in RAM until the drain task sends them. A power of two
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 128
+#endif
+
+#if (TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) != 0
+#error "TRACE_BUFFER_EVENTS must be a power of two"
+#endif
+
+// UART the drain task sends frames on, shared with the Retarget printf layer
+#define TRACE_UART_PORT 0
+#define TRACE_BAUD_RATE 9600
+
+// Drain task, and the ticks it sleeps once the buffer is empty
+#define TRACE_DRAIN_PRIORITY osPriorityLow
+#ifndef TRACE_DRAIN_STACK_SIZE
+#define TRACE_DRAIN_STACK_SIZE DEFAULT_STACK_SIZE
+#endif
+#define TRACE_DRAIN_PERIOD 10
+
+// SysTick entry and exit are two events every tick, more than the drain task can send at 9600
+// baud. Set to 1 with a faster UART or for short captures
+#ifndef TRACE_SYSTICK
+#define TRACE_SYSTICK 0
+#endif
+#define SYSTICK_EXCEPTION 15
+
+// Frame on the UART: sync byte, event, task index, data (2 bytes), DWT_CYCCNT (4 bytes), and the
+// XOR of the 8 bytes after the sync byte. Multi-byte fields are little endian. printf text never
+// holds the sync byte, so tools/trace_decode.py finds frames between printf output
+#define TRACE_SYNC 0xA5
+#define TRACE_FRAME_SIZE 10
+
+typedef enum {
+	traceStart 			= 0,		// Drain task started, data is SystemCoreClock in MHz
+	traceLost 			= 1,		// Buffer was full, data is the number of events dropped
+	traceSwitchIn 	= 2,		// data is the priority the task runs at
+	traceSwitchOut 	= 3,		// data is the state the task is left in
+	traceBlock 			= 4,
+	traceUnblock 		= 5,
+	traceSemLend 		= 6,		// data is the low half of the object address
+	traceSemReturn 	= 7,
+	traceMutexLock 	= 8,
+	traceMutexUnlock = 9,
+	traceIsrEnter 	= 10,		// data is the exception number, as in IPSR. SysTick is 15
+	traceIsrExit 		= 11
+} traceEventType_t;
+
+typedef struct {
+	uint32_t cycles;
+	uint8_t event;
+	uint8_t task;
+	uint16_t data;
+} traceEvent_t;
+
+// Trace methods. Without __TRACE every TRACE_EVENT compiles to nothing
+#ifdef __TRACE
+#define TRACE_EVENT(event, task, data) traceRecord((event), (task), (uint32_t)(uintptr_t)(data))
+
+// Writes an event into the buffer. Safe from any context, a few cycles with interrupts disabled.
+// Events of the drain task itself are left out, so sending them does not make more of them
+void traceRecord(traceEventType_t event, tcb_t *task, uint32_t data);
+
+// Starts the task that sends the buffer over the UART
+osError_t osTraceStart(void);
+#else
+#define TRACE_EVENT(event, task, data)
+#endif
+
+#endif //__TRACE_H
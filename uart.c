@@ -407,6 +407,27 @@ uint8_t UARTReceiveChar( uint32_t portNum)
 	#endif
 }
 
+/*****************************************************************************
+** Function name:		UARTCharReady
+**
+** Descriptions:		Check if a received character is waiting, so a task
+**						can poll the port instead of spinning in UARTReceiveChar
+**
+** parameters:			portNum
+** Returned value:		1 if UARTReceiveChar returns without waiting, 0 if not
+** 
+*****************************************************************************/
+uint32_t UARTCharReady( uint32_t portNum)
+{
+	#ifdef __RTGT_UART
+		LPC_UART_TypeDef *LPC_UART;
+		LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
+		return ((LPC_UART->LSR & LSR_RDR) != 0);
+	#else
+		return (ITM_CheckChar() == 1);
+	#endif
+}
+
 /******************************************************************************
 **                            End Of File
 ******************************************************************************/